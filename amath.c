@@ -8,7 +8,7 @@
 #define HELP "AMath CLI\n"\
              "Aria Diniz - 2025\n\n"\
              "amath [CALC] - will calculate CALC for all values provided to STDIN\n\n"\
-             "[CALC] -> mean, median, stdev, ndist, min, max, range, normalize, zscore, variance\n"\
+             "[CALC] -> mean, median, stdev, ndist, min, max, range, normalize, zscore, variance, sort\n"\
              "This CLI does not handle complex numbers yet.\n"\
 
 #define BUFFER_SIZE 120
@@ -94,6 +94,13 @@ static int transform(size_t* count, char* func) {
     free(zscore);
   } else if (strcmp(func, "variance") == 0 ) {
     printf("%lf\n", amath_variance(data, *count));
+  } else if (strcmp(func, "sort") == 0) {
+    if (amath_sort(data, *count, 4) != 0) {
+      fprintf(stderr, "Error sorting data.\n");
+      free(data);
+      return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < *count; i++) printf("%lf\n", data[i]);
   } else {
     fprintf(stderr, "Unknown option: %s\n", func);
     free(data);
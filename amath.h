@@ -115,6 +115,150 @@ int amath_dft(double complex *data, size_t size, size_t n_threads);
 */
 int amath_inverse_dft(double complex *data, size_t size, size_t n_threads);
 
+/*
+  Performs howmany independent Discrete Fourier Transforms of size elements each,
+  in place. Element j of transform t is data[t * dist + j * stride] (FFTW-style layout).
+  Whole transforms are distributed across n_threads threads and computed several at a
+  time, so prefer this over calling amath_dft in a loop for many small signals.
+  With howmany > 1, transforms must not share elements: dist > (size - 1) * stride
+  (one after the other) or 0 < (howmany - 1) * dist < stride (interleaved), else -1
+  is returned. On error the data is left untouched.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_dft_many(
+  double complex *data,
+  size_t size,
+  size_t howmany,
+  size_t stride,
+  size_t dist,
+  size_t n_threads
+);
+
+/*
+  Performs howmany independent Inverse Fourier Transforms, with the same layout and
+  threading as amath_dft_many. Returns 0 if successfull, Return -1 if not.
+*/
+int amath_inverse_dft_many(
+  double complex *data,
+  size_t size,
+  size_t howmany,
+  size_t stride,
+  size_t dist,
+  size_t n_threads
+);
+
+/*
+  Single precision variants of amath_dft and amath_inverse_dft, with the same
+  arguments and return values.
+*/
+int amath_dftf(float complex *data, size_t size, size_t n_threads);
+int amath_inverse_dftf(float complex *data, size_t size, size_t n_threads);
+
+/*
+  Performs a Discrete Fourier Transform over data stored in split layout, with the
+  real parts in re and the imaginary parts in im. Both arrays are modified.
+  Power of two sizes use a radix-2 FFT. Use n_threads > 1 for multithreading.
+  Returns 0 if successfull, Return -1 if not, in which case re and im are untouched.
+*/
+int amath_dft_split(double *re, double *im, size_t size, size_t n_threads);
+
+/*
+  Performs an Inverse Fourier Transform over data stored in split layout.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_inverse_dft_split(double *re, double *im, size_t size, size_t n_threads);
+
+/*
+  Single precision variants of amath_dft_split and amath_inverse_dft_split.
+*/
+int amath_dft_splitf(float *re, float *im, size_t size, size_t n_threads);
+int amath_inverse_dft_splitf(float *re, float *im, size_t size, size_t n_threads);
+
+/*
+----------------------------------------------------------------------------------
+Multi-Dimensional Fourier Transform
+*/
+
+/*
+  Performs a 2-D Discrete Fourier Transform over the rows x cols row-major matrix data.
+  This method modifies the original array. Rows are transformed in parallel and the
+  matrix is transposed (cache-blocked) between the row and column passes.
+  Use n_threads > 1 for multithreading. Returns 0 if successfull, Return -1 if not.
+*/
+int amath_dft2d(double complex *data, size_t rows, size_t cols, size_t n_threads);
+
+/*
+  Performs a 2-D Inverse Fourier Transform over the rows x cols row-major matrix data.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_inverse_dft2d(double complex *data, size_t rows, size_t cols, size_t n_threads);
+
+/*
+  Performs an N-D Discrete Fourier Transform over the row-major array data, whose
+  n_dims dimensions are given in dims (dims[n_dims - 1] varies fastest).
+  Returns 0 if successfull, Return -1 if not, including when the product of dims
+  overflows a size_t.
+*/
+int amath_dftnd(double complex *data, const size_t *dims, size_t n_dims, size_t n_threads);
+
+/*
+  Performs an N-D Inverse Fourier Transform over the row-major array data.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_inverse_dftnd(double complex *data, const size_t *dims, size_t n_dims, size_t n_threads);
+
+/*
+----------------------------------------------------------------------------------
+Convolution and Cross-Correlation
+*/
+
+/*
+  Output modes:
+  AMATH_CONV_FULL  -> every overlap, n_signal + n_kernel - 1 samples.
+  AMATH_CONV_SAME  -> the n_signal central samples of the full result (like scipy,
+                      even when n_kernel > n_signal; numpy returns max of both).
+  AMATH_CONV_VALID -> only full overlaps, n_signal - n_kernel + 1 samples. Requires
+                      n_kernel <= n_signal (numpy would swap the operands).
+*/
+typedef enum ConvolutionMode {
+  AMATH_CONV_FULL,
+  AMATH_CONV_SAME,
+  AMATH_CONV_VALID
+} ConvolutionMode;
+
+/*
+  Calculates the linear convolution of signal and kernel. Short kernels are convolved
+  directly; otherwise the FFT is used, with overlap-save blocks when the kernel is much
+  shorter than the signal. Use n_threads > 1 for multithreading. The length of the
+  result is stored in n_result if it is not NULL.
+  Return a new 1D array with the result, or NULL on error (including AMATH_CONV_VALID
+  with n_kernel > n_signal). Don't forget to free the memory of the result after usage.
+*/
+double *amath_convolve(
+  double *signal,
+  size_t n_signal,
+  double *kernel,
+  size_t n_kernel,
+  ConvolutionMode mode,
+  size_t n_threads,
+  size_t *n_result
+);
+
+/*
+  Calculates the cross-correlation sum(data1[i + k] * data2[i]) for every lag k.
+  In AMATH_CONV_FULL mode, element j of the result is the lag j - (n2 - 1).
+  Same modes, threading, and return values as amath_convolve.
+*/
+double *amath_xcorr(
+  double *data1,
+  size_t n1,
+  double *data2,
+  size_t n2,
+  ConvolutionMode mode,
+  size_t n_threads,
+  size_t *n_result
+);
+
 /*
 ----------------------------------------------------------------------------------
 Mean
@@ -125,17 +269,108 @@ Mean
 */
 double amath_mean(double* restrict data, size_t n_elements);
 
+/*
+----------------------------------------------------------------------------------
+Sorting
+*/
+
+/*
+  Sorts the n_elements of data in ascending order, in place, with a radix sort on
+  the IEEE-754 bit pattern. -0.0 sorts before 0.0 and NaNs are placed last, in their
+  original order. Inputs large enough are split across n_threads threads and merged.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_sort(double *data, size_t n_elements, size_t n_threads);
+
+/*
+  Stores in order the indexes that sort the n_elements of data in ascending order,
+  with the same ordering and threading as amath_sort. The sort is stable: equal
+  values keep their index order. data is not modified.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_argsort(double *data, size_t n_elements, size_t *order, size_t n_threads);
+
 /*
 ----------------------------------------------------------------------------------
 Median
 */
 
 /* Calculates the median of the first n_elements of the values in the 1D array data.
-   If sorted is 0, the data will be sorted using QuickSort.
+   If sorted is 0, the data will be sorted in ascending order using amath_sort.
    Return NAN if data is NULL or if n_elements <= 0.
 */
 double amath_median(double* restrict data, size_t n_elements, unsigned int sorted);
 
+/*
+----------------------------------------------------------------------------------
+Quantile Sketches
+*/
+
+/*
+  Mergeable streaming quantile sketch (KLL). It keeps fewer than 3 * k values
+  however long the stream is, and answers quantile and rank queries with a rank
+  error that shrinks as 1 / k (about 1% to 2% for the default k = 200). The exact
+  minimum and maximum are kept. A sketch is not thread-safe: give every thread
+  or process its own and merge them.
+*/
+typedef struct QuantileSketch QuantileSketch;
+
+/*
+  Creates an empty sketch with accuracy parameter k (0 for the default of 200,
+  otherwise from 8 to 65535). Returns NULL on error. Don't forget to call amath_destroy_sketch
+  on it after usage.
+*/
+QuantileSketch *amath_sketch_create(unsigned int k);
+
+/*
+  Safely destroys a QuantileSketch*
+*/
+void amath_destroy_sketch(QuantileSketch *sketch);
+
+/*
+  Adds the first n_elements of data to the sketch. NaNs are ignored.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_sketch_update(QuantileSketch *sketch, double *data, size_t n_elements);
+
+/*
+  Adds every value summarised by other to sketch, leaving other unchanged. Sketches
+  with different k merge with the accuracy of the smaller one.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_sketch_merge(QuantileSketch *sketch, const QuantileSketch *other);
+
+/*
+  Returns the number of values added to the sketch.
+*/
+unsigned long long amath_sketch_count(const QuantileSketch *sketch);
+
+/*
+  Returns an estimate of the q quantile (0 <= q <= 1) of the values added to the
+  sketch, e.g. q = 0.99 for p99. q = 0 and q = 1 return the exact min and max.
+  Returns NAN on error or if the sketch is empty.
+*/
+double amath_sketch_quantile(const QuantileSketch *sketch, double q);
+
+/*
+  Returns an estimate of the fraction of the values added to the sketch that are
+  less than or equal to value. Returns NAN on error or if the sketch is empty.
+*/
+double amath_sketch_rank(const QuantileSketch *sketch, double value);
+
+/*
+  Serialises the sketch to a new compact byte buffer, storing its size in n_bytes.
+  The buffer can be read back with amath_sketch_deserialize on machines of the
+  same byte order. Returns NULL on error. Don't forget to free it after usage.
+*/
+unsigned char *amath_sketch_serialize(const QuantileSketch *sketch, size_t *n_bytes);
+
+/*
+  Creates a sketch from a buffer written by amath_sketch_serialize.
+  Returns NULL on error or if the buffer is not a valid sketch.
+*/
+QuantileSketch *amath_sketch_deserialize(const unsigned char *buffer, size_t n_bytes);
+
 /*
 ----------------------------------------------------------------------------------
 Standard Deviation
@@ -192,6 +427,117 @@ double amath_pcorr(
   size_t n_elements 
 );
 
+/*
+----------------------------------------------------------------------------------
+Ranks and Spearman Correlation
+*/
+
+/*
+  Rank transform of a series, reusable by every rank statistic computed on it.
+  ranks holds the average rank (starting at 1, ties share the mean of their
+  positions) of every element and order the indexes that sort the series in
+  ascending order. tie_pairs is the number of pairs of tied elements and
+  sum_squares the sum of the squared deviations of the ranks from their mean.
+*/
+typedef struct Ranks {
+  double *ranks;
+  size_t *order;
+  size_t n_elements;
+  double tie_pairs, sum_squares;
+} Ranks;
+
+/*
+  Ranks the n_elements of data, sorting it once with up to n_threads threads.
+  Returns a new handle, or NULL on error. Don't forget to call amath_destroy_ranks
+  on it after usage.
+*/
+Ranks *amath_rank(double *data, size_t n_elements, size_t n_threads);
+
+/*
+  Ranks a new series of the same size into an existing handle, reusing its buffers.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_rerank(Ranks *ranks, double *data, size_t n_threads);
+
+/*
+  Safely destroys a Ranks*
+*/
+void amath_destroy_ranks(Ranks *ranks);
+
+/*
+  Calculates Spearman's rank correlation coefficient between two datasets, the
+  Pearson correlation of their average ranks. Returns NAN on error or if either
+  dataset is constant.
+*/
+double amath_scorr(double *data1, double *data2, size_t n_elements);
+
+/*
+  Spearman's rank correlation between two series ranked by amath_rank, in O(n).
+  Returns NAN on error, mismatched sizes or if either series is constant.
+*/
+double amath_scorr_ranked(const Ranks *x, const Ranks *y);
+
+/*
+  Kendall's tau between two series ranked by amath_rank, in O(n log n) without
+  sorting either series again. Matches amath_kcorr. Returns NAN on error or
+  mismatched sizes.
+*/
+double amath_kcorr_ranked(const Ranks *x, const Ranks *y);
+
+/*
+----------------------------------------------------------------------------------
+Correlation and Covariance Matrices
+*/
+
+/*
+  Correlation coefficient used by amath_corr_matrix.
+*/
+typedef enum CorrelationMethod {
+  AMATH_CORR_PEARSON,
+  AMATH_CORR_KENDALL,
+  AMATH_CORR_SPEARMAN
+} CorrelationMethod;
+
+/*
+  Index of the entry (i, j), with i <= j, of a packed symmetric n x n matrix as
+  returned by amath_cov_matrix and amath_corr_matrix. The upper triangle is stored
+  row by row: (0, 0), (0, 1), ..., (0, n - 1), (1, 1), ..., (n - 1, n - 1).
+*/
+#define AMATH_PACKED_INDEX(i, j, n) ((i) * (n) - (i) * ((i) - 1) / 2 + (j) - (i))
+
+/*
+  Calculates the covariance between every pair of the n_series series of data, each
+  holding n_elements observations stored contiguously (column-major: series s starts
+  at data[s * n_elements]). Use population = 1 for population covariance, 0 for sample.
+  Every series is centred once and the matrix is computed with a cache-blocked kernel
+  using n_threads threads. Returns a new packed array of n_series * (n_series + 1) / 2
+  elements (see AMATH_PACKED_INDEX), or NULL on error. Don't forget to free it after usage.
+*/
+double *amath_cov_matrix(
+  double *data,
+  size_t n_elements,
+  size_t n_series,
+  unsigned int population,
+  size_t n_threads
+);
+
+/*
+  Calculates the correlation coefficient between every pair of the n_series series of
+  data, with the same layout, threading and packed result as amath_cov_matrix.
+  AMATH_CORR_PEARSON standardises every series once; AMATH_CORR_KENDALL sorts every
+  series once and computes each pair in O(n log n), matching amath_kcorr;
+  AMATH_CORR_SPEARMAN ranks every series once and correlates the ranks.
+  Entries involving a constant series are NAN for Pearson and Spearman. Returns NULL on error
+  (including n_elements < 2). Don't forget to free the result after usage.
+*/
+double *amath_corr_matrix(
+  double *data,
+  size_t n_elements,
+  size_t n_series,
+  CorrelationMethod method,
+  size_t n_threads
+);
+
 /*
 ----------------------------------------------------------------------------------
 Min
@@ -248,6 +594,30 @@ Z-Score
 */
 double* amath_zscore(double* restrict data, size_t n_elements);
 
+/*
+----------------------------------------------------------------------------------
+Single Precision Statistics
+*/
+
+/*
+  float variants of amath_mean, amath_stdev, amath_variance, amath_covariance and
+  amath_pcorr. Sums are accumulated in double and the result is returned as double.
+  Same arguments and error values as the double versions.
+*/
+double amath_meanf(float* restrict data, size_t n_elements);
+double amath_stdevf(float* restrict data, unsigned int population, size_t n_elements);
+double amath_variancef(float* data, size_t n_elements);
+double amath_covariancef(float* data1, float* data2, unsigned int population, size_t n_elements);
+double amath_pcorrf(float* restrict data1, float* restrict data2, size_t n_elements);
+
+/*
+  float variants of amath_min, amath_max and amath_range.
+  Return NAN if n_elements is 0 or data is NULL.
+*/
+float amath_minf(float* restrict data, size_t n_elements);
+float amath_maxf(float* restrict data, size_t n_elements);
+float amath_rangef(float* restrict data, size_t n_elements);
+
 /*
 ----------------------------------------------------------------------------------
 Normal Distribution
@@ -274,4 +644,256 @@ Poisson Distribution
 */
 double *amath_pdist(int *data, double lambda, size_t n_elements, size_t n_threads);
 
+/*
+----------------------------------------------------------------------------------
+Histograms
+*/
+
+/*
+  Counts of values per bin. Bin i holds edges[i] <= x < edges[i + 1], and the last
+  bin also holds x == edges[n_bins]. underflow and overflow count the values below
+  edges[0] and above edges[n_bins]; NaNs are not counted. uniform is 1 when all bins
+  have the same width.
+*/
+typedef struct Histogram {
+  double *edges;
+  size_t *counts;
+  size_t n_bins;
+  size_t underflow, overflow;
+  int uniform;
+} Histogram;
+
+/*
+  Builds a histogram of n_bins fixed-width bins over [min, max] from the first
+  n_elements of data. If min >= max, the range of the values of data that are not
+  NaN is used, and NULL is returned if they are all NaN. Values are binned
+  in vectorised blocks, with every thread of n_threads counting into its own
+  histogram before they are merged. Returns a new histogram, or NULL on error.
+  Don't forget to call amath_destroy_histogram on it after usage.
+*/
+Histogram *amath_histogram(
+  double *data,
+  size_t n_elements,
+  size_t n_bins,
+  double min,
+  double max,
+  size_t n_threads
+);
+
+/*
+  Builds a histogram of n_bins bins holding about the same number of values each,
+  with edges at the quantiles of data (linearly interpolated, NaNs ignored).
+  Returns a new histogram, or NULL on error. Don't forget to call
+  amath_destroy_histogram on it after usage.
+*/
+Histogram *amath_histogram_quantile(double *data, size_t n_elements, size_t n_bins, size_t n_threads);
+
+/*
+  Adds the first n_elements of data to the counts of an existing histogram, keeping
+  its edges, so a stream can be binned one chunk at a time.
+  Returns 0 if successfull, Return -1 if not.
+*/
+int amath_histogram_update(Histogram *histogram, double *data, size_t n_elements, size_t n_threads);
+
+/*
+  Safely destroys a Histogram*
+*/
+void amath_destroy_histogram(Histogram *histogram);
+
+/*
+----------------------------------------------------------------------------------
+Kernel Density Estimation
+*/
+
+/*
+  Estimates the density of the first n_elements of data with a Gaussian kernel,
+  at the n_points evenly spaced points x_k = min + k * (max - min) / (n_points - 1).
+  The values are binned linearly onto the grid and convolved with the kernel via
+  amath_convolve, so the cost is O(n_elements + n_points log n_points).
+  Use bandwidth <= 0 for Silverman's rule of thumb, and min >= max to cover the
+  data range extended by 3 bandwidths; either one sorts a copy of the data first,
+  adding O(n_elements log n_elements). NaNs are ignored. Returns a new array of
+  n_points densities, or NULL on error (including constant data with no bandwidth
+  given). Don't forget to free it after usage.
+*/
+double *amath_kde(
+  double *data,
+  size_t n_elements,
+  double bandwidth,
+  double min,
+  double max,
+  size_t n_points,
+  size_t n_threads
+);
+
+/*
+----------------------------------------------------------------------------------
+Memory and Thread Placement
+*/
+
+/*
+  Large result and scratch buffers (1 MiB and more) are left untouched at allocation,
+  so each page lands on the NUMA node of the worker thread that writes it first.
+*/
+#define AMATH_ALLOC_FIRST_TOUCH 0x1u
+/* Large buffers are aligned to 2 MiB and backed by transparent huge pages. */
+#define AMATH_ALLOC_HUGE_PAGES 0x2u
+/*
+  The threads of each call are pinned to distinct CPUs the process may run on, taken
+  in turn from a cursor shared by the whole process, so concurrent calls spread over
+  the cores. Threads that can't be pinned run unpinned.
+*/
+#define AMATH_PIN_THREADS 0x4u
+
+/*
+  Sets the placement policy of the buffers and worker threads of the multithreaded
+  functions, a combination of the flags above (0, the default, turns them all off).
+  Applies to the calls started afterwards. Returns 0 if successfull, Return -1 if a
+  flag is unknown or not supported on this system.
+*/
+int amath_set_alloc_policy(unsigned int policy);
+
+/*
+  Returns the current placement policy.
+*/
+unsigned int amath_get_alloc_policy(void);
+
+/*
+----------------------------------------------------------------------------------
+Asynchronous Jobs
+*/
+
+/*
+  Handle to a computation running on the library's job workers (one per CPU), which
+  are started on the first submission. The arrays given to a job must stay valid
+  until it ends.
+*/
+typedef struct Job Job;
+
+typedef enum JobStatus {
+  AMATH_JOB_QUEUED,
+  AMATH_JOB_RUNNING,
+  AMATH_JOB_DONE,
+  AMATH_JOB_FAILED,
+  AMATH_JOB_CANCELLED
+} JobStatus;
+
+/*
+  Body of a job. Receives its argument and the result of the job it was chained to
+  (NULL for submitted jobs), and returns the job result, or NULL on failure.
+*/
+typedef void *jobfunc(void *arg, void *previous);
+
+/*
+  Queues func(arg, NULL). Don't forget to call amath_destroy_job on the returned
+  handle. Returns NULL on error.
+*/
+Job *amath_submit(jobfunc func, void *arg);
+
+/*
+  Queues a job that runs func(arg, result of job) once job is done. If job fails or
+  is cancelled, the follow-up is cancelled. Returns NULL on error.
+*/
+Job *amath_job_then(Job *job, jobfunc func, void *arg);
+
+/*
+  Asynchronous amath_dft and amath_inverse_dft. The job result is data.
+  Like every amath_submit_* function, the job calls the library function, which
+  spawns its own threads for the call: n_threads, capped when the job starts to
+  the number of workers divided by the number of jobs running.
+*/
+Job *amath_submit_dft(double complex *data, size_t size, size_t n_threads);
+Job *amath_submit_inverse_dft(double complex *data, size_t size, size_t n_threads);
+
+/*
+  Asynchronous amath_ndist and amath_pdist. The job result is the new array, to be
+  freed by the caller.
+*/
+Job *amath_submit_ndist(double *data, size_t n_elements, size_t n_threads);
+Job *amath_submit_pdist(int *data, double lambda, size_t n_elements, size_t n_threads);
+
+/*
+  Returns the current status of job without blocking.
+*/
+JobStatus amath_job_poll(Job *job);
+
+/*
+  Waits up to timeout_ms milliseconds (forever if negative) for job to end.
+  Returns its status, AMATH_JOB_QUEUED or AMATH_JOB_RUNNING on timeout.
+*/
+JobStatus amath_job_wait(Job *job, long timeout_ms);
+
+/*
+  Cancels job and the jobs chained to it if it has not started yet. A running job
+  completes. Returns 0 if successfull, Return -1 if not.
+*/
+int amath_job_cancel(Job *job);
+
+/*
+  Returns the result of a job that is done, NULL otherwise.
+*/
+void *amath_job_result(Job *job);
+
+/*
+  Releases the handle. A queued or running job still completes unless it was
+  cancelled. The job result is not freed.
+*/
+void amath_destroy_job(Job *job);
+
+/*
+----------------------------------------------------------------------------------
+Profiling
+*/
+
+/*
+  Counters of one instrumented function, accumulated since the last reset.
+  Times are in nanoseconds. cpu_ns is the process CPU time spent during the calls,
+  alloc_ns and spawn_ns the time spent allocating buffers and creating threads, and
+  chunks, chunk_ns and chunk_max_ns describe the work chunks run by worker threads.
+*/
+typedef struct ProfileStats {
+  const char *function;
+  unsigned long long calls;
+  unsigned long long bytes;
+  unsigned long long wall_ns;
+  unsigned long long cpu_ns;
+  unsigned long long alloc_ns;
+  unsigned long long spawn_ns;
+  unsigned long long chunks;
+  unsigned long long chunk_ns;
+  unsigned long long chunk_max_ns;
+} ProfileStats;
+
+/*
+  Turns the collection of counters on (enabled = 1) or off (enabled = 0).
+  Instrumentation only exists when the library is built with AMATH_PROFILE defined
+  (make PROFILE=1). Returns 0 if successfull, -1 if the library was built without it.
+*/
+int amath_profile_enable(unsigned int enabled);
+
+/*
+  Turns the recording of trace events on or off. Enabling it discards the events of
+  the previous run and reuses their slots, so only enable it while no library call
+  is running. Returns 0 if successfull, -1 if built without AMATH_PROFILE.
+*/
+int amath_trace_enable(unsigned int enabled);
+
+/*
+  Copies the counters of up to max_stats functions that were called since the last
+  reset into stats. Returns the number of entries written.
+*/
+size_t amath_stats_snapshot(ProfileStats *stats, size_t max_stats);
+
+/*
+  Sets every counter back to zero.
+*/
+void amath_stats_reset(void);
+
+/*
+  Writes the recorded trace events to path in Chrome trace format, to be opened in
+  chrome://tracing or Perfetto. Events still being recorded by running calls are
+  left out. Returns 0 if successfull, Return -1 if not.
+*/
+int amath_trace_dump(const char *path);
+
 #endif  // __ADVANCED_MATH_LIB
@@ -0,0 +1,152 @@
+/*
+MIT License
+
+Copyright (c) 2024 Aria Diniz
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __ADVANCED_MATH_LIB_INLINE
+#define __ADVANCED_MATH_LIB_INLINE
+
+/*
+  Optional header-only fast path for tiny inputs. Every amath_*_inline function
+  computes what the library function of the same name computes, but it is compiled
+  into the caller:
+
+  - when n_elements is a compile-time constant up to AMATH_INLINE_MAX, the loop is
+    fully unrolled into a fixed-size kernel and the NULL/size checks fold away;
+  - when n_elements is only known at runtime, inputs up to AMATH_INLINE_MAX run an
+    inline loop and larger ones call the library.
+
+  Results are not guaranteed to be bit-identical to the library: the caller's flags
+  decide whether products are contracted into FMAs, so the variance and standard
+  deviation may differ in the last bits. The mean, min, max and range match.
+
+  Link with -lamath -lm as usual, or with libamath.a (make static) and -flto to let
+  the compiler inline the library calls too.
+*/
+
+#include "amath.h"
+#include <math.h>
+#include <stddef.h>
+
+#ifndef AMATH_INLINE_MAX
+#define AMATH_INLINE_MAX 32
+#endif
+
+#define AMATH_INLINE_FUNCTION static inline __attribute__((always_inline))
+
+/*
+  Nonzero when n is known at compile time to be small enough for the fixed-size
+  kernels, so the dispatch below is resolved by the compiler.
+*/
+#define AMATH_INLINE_FIXED(n) (__builtin_constant_p(n) && (n) <= AMATH_INLINE_MAX)
+
+AMATH_INLINE_FUNCTION double amath_inline_sum(const double *data, size_t n_elements) {
+  double sum = 0;
+#pragma GCC unroll 32
+  for (size_t i = 0; i < n_elements; i++) sum += data[i];
+  return sum;
+}
+
+AMATH_INLINE_FUNCTION double amath_inline_min(const double *data, size_t n_elements) {
+  double min = data[0];
+#pragma GCC unroll 32
+  for (size_t i = 1; i < n_elements; i++) {
+    if (min > data[i]) min = data[i];
+  }
+  return min;
+}
+
+AMATH_INLINE_FUNCTION double amath_inline_max(const double *data, size_t n_elements) {
+  double max = data[0];
+#pragma GCC unroll 32
+  for (size_t i = 1; i < n_elements; i++) {
+    if (max < data[i]) max = data[i];
+  }
+  return max;
+}
+
+AMATH_INLINE_FUNCTION double amath_inline_squares(const double *data, double mean, size_t n_elements) {
+  double sum = 0;
+#pragma GCC unroll 32
+  for (size_t i = 0; i < n_elements; i++) sum += (data[i] - mean) * (data[i] - mean);
+  return sum;
+}
+
+/*
+  Inline amath_mean.
+*/
+AMATH_INLINE_FUNCTION double amath_mean_inline(double *data, size_t n_elements) {
+  if (!AMATH_INLINE_FIXED(n_elements) && n_elements > AMATH_INLINE_MAX) return amath_mean(data, n_elements);
+  if (data == NULL || n_elements == 0) return NAN;
+  return amath_inline_sum(data, n_elements) / n_elements;
+}
+
+/*
+  Inline amath_min.
+*/
+AMATH_INLINE_FUNCTION double amath_min_inline(double *data, size_t n_elements) {
+  if (!AMATH_INLINE_FIXED(n_elements) && n_elements > AMATH_INLINE_MAX) return amath_min(data, n_elements);
+  if (data == NULL || n_elements == 0) return NAN;
+  return amath_inline_min(data, n_elements);
+}
+
+/*
+  Inline amath_max.
+*/
+AMATH_INLINE_FUNCTION double amath_max_inline(double *data, size_t n_elements) {
+  if (!AMATH_INLINE_FIXED(n_elements) && n_elements > AMATH_INLINE_MAX) return amath_max(data, n_elements);
+  if (data == NULL || n_elements == 0) return NAN;
+  return amath_inline_max(data, n_elements);
+}
+
+/*
+  Inline amath_range.
+*/
+AMATH_INLINE_FUNCTION double amath_range_inline(double *data, size_t n_elements) {
+  if (!AMATH_INLINE_FIXED(n_elements) && n_elements > AMATH_INLINE_MAX) return amath_range(data, n_elements);
+  if (data == NULL || n_elements == 0) return NAN;
+  return amath_inline_max(data, n_elements) - amath_inline_min(data, n_elements);
+}
+
+/*
+  Inline amath_variance (population variance).
+*/
+AMATH_INLINE_FUNCTION double amath_variance_inline(double *data, size_t n_elements) {
+  if (!AMATH_INLINE_FIXED(n_elements) && n_elements > AMATH_INLINE_MAX) return amath_variance(data, n_elements);
+  if (data == NULL || n_elements == 0) return NAN;
+  double mean = amath_inline_sum(data, n_elements) / n_elements;
+  return amath_inline_squares(data, mean, n_elements) / n_elements;
+}
+
+/*
+  Inline amath_stdev. Use population = 1 for population standard deviation, 0 for sample.
+*/
+AMATH_INLINE_FUNCTION double amath_stdev_inline(double *data, unsigned int population, size_t n_elements) {
+  if (!AMATH_INLINE_FIXED(n_elements) && n_elements > AMATH_INLINE_MAX) {
+    return amath_stdev(data, population, n_elements);
+  }
+  if (data == NULL || n_elements == 0) return NAN;
+  double mean = amath_inline_sum(data, n_elements) / n_elements;
+  return sqrt(amath_inline_squares(data, mean, n_elements) / (n_elements - (population ? 0 : 1)));
+}
+
+#endif  // __ADVANCED_MATH_LIB_INLINE
@@ -0,0 +1,512 @@
+#include "../amath.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HELP "AMath Benchmarks\n\n"\
+             "amath_bench [OPTIONS]\n\n"\
+             "--min-size N     smallest input size (default 1e2)\n"\
+             "--max-size N     largest input size (default 1e8)\n"\
+             "--threads LIST   comma separated thread counts (default 1,2,4,... up to the CPU count)\n"\
+             "--filter TEXT    only run functions whose name contains TEXT\n"\
+             "--json PATH      write machine-readable results to PATH ('-' for STDOUT)\n"\
+             "--min-time S     minimum measured time per point, in seconds (default 0.2)\n"
+
+#define MAX_THREAD_COUNTS 16
+#define MAX_REPS 1000
+#define CONV_KERNEL 101
+#define XCORR_KERNEL 1024
+#define BATCH_SIZE 256
+#define MATRIX_SERIES 64
+#define HISTOGRAM_BINS 64
+#define KDE_POINTS 1024
+
+/*
+  Inputs a case uses. Only those are allocated, at the size the case runs with, along
+  with the arrays prepare refreshes them from.
+*/
+#define INPUT_X 0x1u
+#define INPUT_Y 0x2u
+#define INPUT_SCRATCH 0x4u
+#define INPUT_SPLIT 0x8u
+#define INPUT_XF 0x10u
+#define INPUT_YF 0x20u
+#define INPUT_SPLITF 0x40u
+#define INPUT_K 0x80u
+#define INPUT_ORDER 0x100u
+#define INPUT_COMPLEX 0x200u
+#define INPUT_COMPLEXF 0x400u
+
+/*
+  Inputs of the case being run. Cases that modify their input refresh it in
+  prepare, which is not timed.
+*/
+struct bench_ctx {
+  size_t n;
+  double *x, *y, *scratch;
+  double *re, *im;
+  float *xf, *yf, *ref, *imf;
+  int *k;
+  size_t *order;
+  double complex *c;
+  float complex *cf;
+  double kernel[XCORR_KERNEL];
+  Individuals *individuals;
+};
+
+struct bench_case {
+  const char *name;
+  /* Sizes are swept within [min_size, max_size], rounded down to a multiple of min_size. */
+  size_t min_size, max_size;
+  int threaded;
+  /* Round the swept size down to a power of two, for the FFT paths. */
+  int pow2;
+  /* Bytes read and written per element, used for the GB/s figure. */
+  double bytes_per_element;
+  unsigned int inputs;
+  void (*prepare)(struct bench_ctx *ctx);
+  void (*run)(struct bench_ctx *ctx, size_t n_threads);
+};
+
+static volatile double sink;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void refresh_complex(struct bench_ctx *ctx) {
+  for (size_t i = 0; i < ctx->n; i++) ctx->c[i] = CMPLX(ctx->x[i], ctx->y[i]);
+}
+
+static void refresh_complexf(struct bench_ctx *ctx) {
+  for (size_t i = 0; i < ctx->n; i++) ctx->cf[i] = CMPLXF(ctx->xf[i], ctx->yf[i]);
+}
+
+static void refresh_split(struct bench_ctx *ctx) {
+  memcpy(ctx->re, ctx->x, sizeof(double) * ctx->n);
+  memcpy(ctx->im, ctx->y, sizeof(double) * ctx->n);
+}
+
+static void refresh_splitf(struct bench_ctx *ctx) {
+  memcpy(ctx->ref, ctx->xf, sizeof(float) * ctx->n);
+  memcpy(ctx->imf, ctx->yf, sizeof(float) * ctx->n);
+}
+
+static void refresh_scratch(struct bench_ctx *ctx) {
+  memcpy(ctx->scratch, ctx->x, sizeof(double) * ctx->n);
+}
+
+static void *ga_fitness(Individuals *individuals) {
+  for (int i = 0; i < individuals->n_individuals; i++) {
+    Individual *individual = individuals->individual_array[i];
+    double total = 0;
+    for (int j = 0; j < individuals->number_weights; j++) total += individual->weights[j];
+    individual->fitness = total;
+  }
+  return NULL;
+}
+
+static void prepare_ga(struct bench_ctx *ctx) {
+  if (ctx->individuals == NULL) {
+    ctx->individuals = amath_generate_individuals(ctx->n, 0.05, 0.01, 0.25, 4, 0.0, 1.0);
+  }
+}
+
+static void run_ga(struct bench_ctx *ctx, size_t n_threads) {
+  amath_fit(ctx->individuals, ga_fitness);
+  amath_mutate(ctx->individuals);
+  amath_reproduce(ctx->individuals);
+}
+
+static void run_kcorr(struct bench_ctx *ctx, size_t n_threads) { sink += amath_kcorr(ctx->x, ctx->y, ctx->n); }
+
+static void run_rank(struct bench_ctx *ctx, size_t n_threads) {
+  amath_destroy_ranks(amath_rank(ctx->x, ctx->n, n_threads));
+}
+
+static void run_scorr(struct bench_ctx *ctx, size_t n_threads) { sink += amath_scorr(ctx->x, ctx->y, ctx->n); }
+static void run_dft(struct bench_ctx *ctx, size_t n_threads) { amath_dft(ctx->c, ctx->n, n_threads); }
+static void run_inverse_dft(struct bench_ctx *ctx, size_t n_threads) { amath_inverse_dft(ctx->c, ctx->n, n_threads); }
+static void run_dftf(struct bench_ctx *ctx, size_t n_threads) { amath_dftf(ctx->cf, ctx->n, n_threads); }
+static void run_inverse_dftf(struct bench_ctx *ctx, size_t n_threads) { amath_inverse_dftf(ctx->cf, ctx->n, n_threads); }
+static void run_dft_split(struct bench_ctx *ctx, size_t n_threads) { amath_dft_split(ctx->re, ctx->im, ctx->n, n_threads); }
+static void run_dft_splitf(struct bench_ctx *ctx, size_t n_threads) { amath_dft_splitf(ctx->ref, ctx->imf, ctx->n, n_threads); }
+
+static void run_inverse_dft_split(struct bench_ctx *ctx, size_t n_threads) {
+  amath_inverse_dft_split(ctx->re, ctx->im, ctx->n, n_threads);
+}
+
+static void run_inverse_dft_splitf(struct bench_ctx *ctx, size_t n_threads) {
+  amath_inverse_dft_splitf(ctx->ref, ctx->imf, ctx->n, n_threads);
+}
+
+static void run_dft_many(struct bench_ctx *ctx, size_t n_threads) {
+  amath_dft_many(ctx->c, BATCH_SIZE, ctx->n / BATCH_SIZE, 1, BATCH_SIZE, n_threads);
+}
+
+static void run_inverse_dft_many(struct bench_ctx *ctx, size_t n_threads) {
+  amath_inverse_dft_many(ctx->c, BATCH_SIZE, ctx->n / BATCH_SIZE, 1, BATCH_SIZE, n_threads);
+}
+
+/* Transforms n (a power of two) elements as a rows x cols grid, as square as possible. */
+static void run_dft2d(struct bench_ctx *ctx, size_t n_threads) {
+  size_t rows = 1;
+  while (rows * rows * 4 <= ctx->n) rows *= 2;
+  amath_dft2d(ctx->c, rows, ctx->n / rows, n_threads);
+}
+
+static void run_convolve(struct bench_ctx *ctx, size_t n_threads) {
+  free(amath_convolve(ctx->x, ctx->n, ctx->kernel, CONV_KERNEL, AMATH_CONV_SAME, n_threads, NULL));
+}
+
+static void run_xcorr(struct bench_ctx *ctx, size_t n_threads) {
+  free(amath_xcorr(ctx->x, ctx->n, ctx->kernel, XCORR_KERNEL, AMATH_CONV_SAME, n_threads, NULL));
+}
+
+static void run_cov_matrix(struct bench_ctx *ctx, size_t n_threads) {
+  free(amath_cov_matrix(ctx->x, ctx->n / MATRIX_SERIES, MATRIX_SERIES, 1, n_threads));
+}
+
+static void run_corr_pearson(struct bench_ctx *ctx, size_t n_threads) {
+  free(amath_corr_matrix(ctx->x, ctx->n / MATRIX_SERIES, MATRIX_SERIES, AMATH_CORR_PEARSON, n_threads));
+}
+
+static void run_corr_kendall(struct bench_ctx *ctx, size_t n_threads) {
+  free(amath_corr_matrix(ctx->x, ctx->n / MATRIX_SERIES, MATRIX_SERIES, AMATH_CORR_KENDALL, n_threads));
+}
+
+static void run_mean(struct bench_ctx *ctx, size_t n_threads) { sink += amath_mean(ctx->x, ctx->n); }
+static void run_sort(struct bench_ctx *ctx, size_t n_threads) { sink += amath_sort(ctx->scratch, ctx->n, n_threads); }
+
+static void run_argsort(struct bench_ctx *ctx, size_t n_threads) {
+  sink += amath_argsort(ctx->x, ctx->n, ctx->order, n_threads);
+}
+
+static void run_sketch(struct bench_ctx *ctx, size_t n_threads) {
+  QuantileSketch *sketch = amath_sketch_create(0);
+  amath_sketch_update(sketch, ctx->x, ctx->n);
+  sink += amath_sketch_quantile(sketch, 0.99);
+  amath_destroy_sketch(sketch);
+}
+
+static void run_median(struct bench_ctx *ctx, size_t n_threads) { sink += amath_median(ctx->scratch, ctx->n, 0); }
+static void run_stdev(struct bench_ctx *ctx, size_t n_threads) { sink += amath_stdev(ctx->x, 1, ctx->n); }
+static void run_variance(struct bench_ctx *ctx, size_t n_threads) { sink += amath_variance(ctx->x, ctx->n); }
+static void run_covariance(struct bench_ctx *ctx, size_t n_threads) { sink += amath_covariance(ctx->x, ctx->y, 1, ctx->n); }
+static void run_pcorr(struct bench_ctx *ctx, size_t n_threads) { sink += amath_pcorr(ctx->x, ctx->y, ctx->n); }
+static void run_min(struct bench_ctx *ctx, size_t n_threads) { sink += amath_min(ctx->x, ctx->n); }
+static void run_max(struct bench_ctx *ctx, size_t n_threads) { sink += amath_max(ctx->x, ctx->n); }
+static void run_range(struct bench_ctx *ctx, size_t n_threads) { sink += amath_range(ctx->x, ctx->n); }
+static void run_normalize(struct bench_ctx *ctx, size_t n_threads) { amath_normalize(ctx->scratch, ctx->n); }
+static void run_zscore(struct bench_ctx *ctx, size_t n_threads) { free(amath_zscore(ctx->x, ctx->n)); }
+static void run_meanf(struct bench_ctx *ctx, size_t n_threads) { sink += amath_meanf(ctx->xf, ctx->n); }
+static void run_stdevf(struct bench_ctx *ctx, size_t n_threads) { sink += amath_stdevf(ctx->xf, 1, ctx->n); }
+static void run_variancef(struct bench_ctx *ctx, size_t n_threads) { sink += amath_variancef(ctx->xf, ctx->n); }
+static void run_pcorrf(struct bench_ctx *ctx, size_t n_threads) { sink += amath_pcorrf(ctx->xf, ctx->yf, ctx->n); }
+static void run_minf(struct bench_ctx *ctx, size_t n_threads) { sink += amath_minf(ctx->xf, ctx->n); }
+static void run_maxf(struct bench_ctx *ctx, size_t n_threads) { sink += amath_maxf(ctx->xf, ctx->n); }
+static void run_rangef(struct bench_ctx *ctx, size_t n_threads) { sink += amath_rangef(ctx->xf, ctx->n); }
+
+static void run_covariancef(struct bench_ctx *ctx, size_t n_threads) {
+  sink += amath_covariancef(ctx->xf, ctx->yf, 1, ctx->n);
+}
+
+static void run_ndist(struct bench_ctx *ctx, size_t n_threads) { free(amath_ndist(ctx->x, ctx->n, n_threads)); }
+static void run_pdist(struct bench_ctx *ctx, size_t n_threads) { free(amath_pdist(ctx->k, 4.0, ctx->n, n_threads)); }
+
+static void run_submit_ndist(struct bench_ctx *ctx, size_t n_threads) {
+  Job *job = amath_submit_ndist(ctx->x, ctx->n, n_threads);
+  amath_job_wait(job, -1);
+  free(amath_job_result(job));
+  amath_destroy_job(job);
+}
+
+static void run_histogram(struct bench_ctx *ctx, size_t n_threads) {
+  amath_destroy_histogram(amath_histogram(ctx->x, ctx->n, HISTOGRAM_BINS, 0.0, 1.0, n_threads));
+}
+
+static void run_histogram_quantile(struct bench_ctx *ctx, size_t n_threads) {
+  amath_destroy_histogram(amath_histogram_quantile(ctx->x, ctx->n, HISTOGRAM_BINS, n_threads));
+}
+
+static void run_kde(struct bench_ctx *ctx, size_t n_threads) {
+  free(amath_kde(ctx->x, ctx->n, 0.0, 0.0, 0.0, KDE_POINTS, n_threads));
+}
+
+/*
+  The O(n^2) functions stop at a size they can finish in a reasonable time.
+  amath_ga_generation times one amath_fit, amath_mutate and amath_reproduce round, and
+  the matrix functions split the elements into MATRIX_SERIES series.
+*/
+static const struct bench_case CASES[] = {
+  {"amath_ga_generation", 0, 1000000, 0, 0, 16, 0, prepare_ga, run_ga},
+  {"amath_kcorr", 0, 10000, 0, 0, 16, INPUT_X | INPUT_Y, NULL, run_kcorr},
+  {"amath_rank", 0, 100000000, 1, 0, 8, INPUT_X, NULL, run_rank},
+  {"amath_scorr", 0, 100000000, 0, 0, 16, INPUT_X | INPUT_Y, NULL, run_scorr},
+  {"amath_dft", 0, 10000, 1, 0, 32, INPUT_COMPLEX, refresh_complex, run_dft},
+  {"amath_inverse_dft", 0, 10000, 1, 0, 32, INPUT_COMPLEX, refresh_complex, run_inverse_dft},
+  {"amath_dft_many", BATCH_SIZE, 100000000, 1, 0, 32, INPUT_COMPLEX, refresh_complex, run_dft_many},
+  {"amath_inverse_dft_many", BATCH_SIZE, 100000000, 1, 0, 32, INPUT_COMPLEX, refresh_complex, run_inverse_dft_many},
+  {"amath_dftf", 0, 100000000, 1, 1, 16, INPUT_COMPLEXF, refresh_complexf, run_dftf},
+  {"amath_inverse_dftf", 0, 100000000, 1, 1, 16, INPUT_COMPLEXF, refresh_complexf, run_inverse_dftf},
+  {"amath_dft_split", 0, 100000000, 1, 1, 32, INPUT_SPLIT, refresh_split, run_dft_split},
+  {"amath_inverse_dft_split", 0, 100000000, 1, 1, 32, INPUT_SPLIT, refresh_split, run_inverse_dft_split},
+  {"amath_dft_splitf", 0, 100000000, 1, 1, 16, INPUT_SPLITF, refresh_splitf, run_dft_splitf},
+  {"amath_inverse_dft_splitf", 0, 100000000, 1, 1, 16, INPUT_SPLITF, refresh_splitf, run_inverse_dft_splitf},
+  {"amath_dft2d", 0, 100000000, 1, 1, 32, INPUT_COMPLEX, refresh_complex, run_dft2d},
+  {"amath_convolve", 0, 100000000, 1, 0, 16, INPUT_X, NULL, run_convolve},
+  {"amath_xcorr", 0, 100000000, 1, 0, 16, INPUT_X, NULL, run_xcorr},
+  {"amath_cov_matrix", MATRIX_SERIES * 2, 100000000, 1, 0, 8, INPUT_X, NULL, run_cov_matrix},
+  {"amath_corr_matrix_pearson", MATRIX_SERIES * 2, 100000000, 1, 0, 8, INPUT_X, NULL, run_corr_pearson},
+  {"amath_corr_matrix_kendall", MATRIX_SERIES * 2, 10000000, 1, 0, 8, INPUT_X, NULL, run_corr_kendall},
+  {"amath_mean", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_mean},
+  {"amath_sort", 0, 100000000, 1, 0, 16, INPUT_SCRATCH, refresh_scratch, run_sort},
+  {"amath_argsort", 0, 100000000, 1, 0, 16, INPUT_X | INPUT_ORDER, NULL, run_argsort},
+  {"amath_median", 0, 100000000, 0, 0, 8, INPUT_SCRATCH, refresh_scratch, run_median},
+  {"amath_sketch_update", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_sketch},
+  {"amath_stdev", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_stdev},
+  {"amath_variance", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_variance},
+  {"amath_covariance", 0, 100000000, 0, 0, 16, INPUT_X | INPUT_Y, NULL, run_covariance},
+  {"amath_pcorr", 0, 100000000, 0, 0, 16, INPUT_X | INPUT_Y, NULL, run_pcorr},
+  {"amath_min", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_min},
+  {"amath_max", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_max},
+  {"amath_range", 0, 100000000, 0, 0, 8, INPUT_X, NULL, run_range},
+  {"amath_normalize", 0, 100000000, 0, 0, 16, INPUT_SCRATCH, refresh_scratch, run_normalize},
+  {"amath_zscore", 0, 100000000, 0, 0, 16, INPUT_X, NULL, run_zscore},
+  {"amath_meanf", 0, 100000000, 0, 0, 4, INPUT_XF, NULL, run_meanf},
+  {"amath_stdevf", 0, 100000000, 0, 0, 4, INPUT_XF, NULL, run_stdevf},
+  {"amath_variancef", 0, 100000000, 0, 0, 4, INPUT_XF, NULL, run_variancef},
+  {"amath_covariancef", 0, 100000000, 0, 0, 8, INPUT_XF | INPUT_YF, NULL, run_covariancef},
+  {"amath_pcorrf", 0, 100000000, 0, 0, 8, INPUT_XF | INPUT_YF, NULL, run_pcorrf},
+  {"amath_minf", 0, 100000000, 0, 0, 4, INPUT_XF, NULL, run_minf},
+  {"amath_maxf", 0, 100000000, 0, 0, 4, INPUT_XF, NULL, run_maxf},
+  {"amath_rangef", 0, 100000000, 0, 0, 4, INPUT_XF, NULL, run_rangef},
+  {"amath_ndist", 0, 100000000, 1, 0, 16, INPUT_X, NULL, run_ndist},
+  {"amath_pdist", 0, 100000000, 1, 0, 12, INPUT_K, NULL, run_pdist},
+  {"amath_submit_ndist", 0, 100000000, 1, 0, 16, INPUT_X, NULL, run_submit_ndist},
+  {"amath_histogram", 0, 100000000, 1, 0, 8, INPUT_X, NULL, run_histogram},
+  {"amath_histogram_quantile", 0, 100000000, 1, 0, 16, INPUT_X, NULL, run_histogram_quantile},
+  {"amath_kde", 0, 100000000, 1, 0, 16, INPUT_X, NULL, run_kde},
+};
+
+#define N_CASES (sizeof(CASES) / sizeof(CASES[0]))
+
+static void destroy_ctx(struct bench_ctx *ctx) {
+  free(ctx->x);
+  free(ctx->y);
+  free(ctx->scratch);
+  free(ctx->re);
+  free(ctx->im);
+  free(ctx->xf);
+  free(ctx->yf);
+  free(ctx->ref);
+  free(ctx->imf);
+  free(ctx->k);
+  free(ctx->order);
+  free(ctx->c);
+  free(ctx->cf);
+  if (ctx->individuals != NULL) amath_destroy_individuals(ctx->individuals);
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+static int create_ctx(struct bench_ctx *ctx, size_t n, unsigned int inputs) {
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->n = n;
+  if (inputs & (INPUT_COMPLEX | INPUT_SPLIT)) inputs |= INPUT_X | INPUT_Y;
+  if (inputs & (INPUT_COMPLEXF | INPUT_SPLITF)) inputs |= INPUT_XF | INPUT_YF;
+  if (inputs & INPUT_SCRATCH) inputs |= INPUT_X;
+
+  int failed = 0;
+#define ALLOCATE(input, field, count) \
+  if (inputs & (input)) failed |= (ctx->field = malloc(sizeof(*ctx->field) * (count))) == NULL
+  ALLOCATE(INPUT_X, x, n);
+  ALLOCATE(INPUT_Y, y, n);
+  ALLOCATE(INPUT_SCRATCH, scratch, n);
+  ALLOCATE(INPUT_SPLIT, re, n);
+  ALLOCATE(INPUT_SPLIT, im, n);
+  ALLOCATE(INPUT_XF, xf, n);
+  ALLOCATE(INPUT_YF, yf, n);
+  ALLOCATE(INPUT_SPLITF, ref, n);
+  ALLOCATE(INPUT_SPLITF, imf, n);
+  ALLOCATE(INPUT_K, k, n);
+  ALLOCATE(INPUT_ORDER, order, n);
+  ALLOCATE(INPUT_COMPLEX, c, n);
+  ALLOCATE(INPUT_COMPLEXF, cf, n);
+#undef ALLOCATE
+  if (failed) {
+    destroy_ctx(ctx);
+    return -1;
+  }
+
+  /* Every case sees the same values, whichever arrays it uses. */
+  srand(42);
+  for (size_t i = 0; i < n; i++) {
+    double x = rand() / (double)RAND_MAX;
+    double y = 0.5 * x + rand() / (double)RAND_MAX;
+    int k = rand() % 16;
+    if (ctx->x != NULL) ctx->x[i] = x;
+    if (ctx->y != NULL) ctx->y[i] = y;
+    if (ctx->xf != NULL) ctx->xf[i] = (float)x;
+    if (ctx->yf != NULL) ctx->yf[i] = (float)y;
+    if (ctx->k != NULL) ctx->k[i] = k;
+  }
+  for (size_t i = 0; i < XCORR_KERNEL; i++) ctx->kernel[i] = 1.0 / (i + 1);
+  return 0;
+}
+
+/*
+  Runs a case until min_time seconds were measured (at least twice, at most
+  MAX_REPS times) and returns the fastest repetition in seconds.
+*/
+static double measure(const struct bench_case *bc, struct bench_ctx *ctx, size_t n_threads, double min_time,
+                      size_t *reps) {
+  double best = INFINITY, total = 0;
+  *reps = 0;
+  while (*reps < 2 || (total < min_time && *reps < MAX_REPS)) {
+    if (bc->prepare != NULL) bc->prepare(ctx);
+    double start = now();
+    bc->run(ctx, n_threads);
+    double elapsed = now() - start;
+    if (elapsed < best) best = elapsed;
+    total += elapsed;
+    *reps += 1;
+  }
+  return best;
+}
+
+static size_t parse_size(const char *text) {
+  return (size_t)strtod(text, NULL);
+}
+
+static size_t parse_threads(const char *text, size_t *threads) {
+  size_t count = 0;
+  char *copy = strdup(text);
+  for (char *token = strtok(copy, ","); token != NULL && count < MAX_THREAD_COUNTS; token = strtok(NULL, ",")) {
+    size_t value = strtoul(token, NULL, 10);
+    if (value > 0) threads[count++] = value;
+  }
+  free(copy);
+  return count;
+}
+
+int main(int argc, char **argv) {
+  size_t min_size = 100, max_size = 100000000;
+  size_t threads[MAX_THREAD_COUNTS];
+  size_t n_thread_counts = 0;
+  const char *filter = NULL, *json_path = NULL;
+  double min_time = 0.2;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      printf(HELP);
+      return EXIT_SUCCESS;
+    } else if (i + 1 < argc && strcmp(argv[i], "--min-size") == 0) {
+      min_size = parse_size(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--max-size") == 0) {
+      max_size = parse_size(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+      n_thread_counts = parse_threads(argv[++i], threads);
+    } else if (i + 1 < argc && strcmp(argv[i], "--filter") == 0) {
+      filter = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--json") == 0) {
+      json_path = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--min-time") == 0) {
+      min_time = strtod(argv[++i], NULL);
+    } else {
+      fprintf(stderr, "Unknown option: %s. Try --help\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_thread_counts == 0) {
+    for (size_t t = 1; t <= (size_t)(cpus > 0 ? cpus : 1) && n_thread_counts < MAX_THREAD_COUNTS; t *= 2) {
+      threads[n_thread_counts++] = t;
+    }
+  }
+
+  int json_stdout = json_path != NULL && strcmp(json_path, "-") == 0;
+  FILE *table = json_stdout ? stderr : stdout;
+  FILE *json = NULL;
+  if (json_path != NULL) {
+    json = json_stdout ? stdout : fopen(json_path, "w");
+    if (json == NULL) {
+      perror("fopen");
+      return EXIT_FAILURE;
+    }
+    fprintf(json, "{\n  \"library\": \"libamath\",\n  \"timestamp\": %ld,\n  \"cpus\": %ld,\n  \"results\": [",
+            (long)time(NULL), cpus);
+  }
+
+  fprintf(table, "%-26s %12s %8s %8s %14s %10s %10s\n",
+          "function", "size", "threads", "reps", "ns/element", "GB/s", "efficiency");
+
+  int first_result = 1;
+  for (size_t n = min_size; n <= max_size; n *= 10) {
+    for (size_t c = 0; c < N_CASES; c++) {
+      const struct bench_case *bc = &CASES[c];
+      if (n < bc->min_size || n > bc->max_size) continue;
+      if (filter != NULL && strstr(bc->name, filter) == NULL) continue;
+
+      size_t elements = n;
+      if (bc->pow2) {
+        while (elements & (elements - 1)) elements &= elements - 1;
+      } else if (bc->min_size > 0) {
+        elements -= elements % bc->min_size;
+      }
+
+      struct bench_ctx ctx;
+      if (create_ctx(&ctx, elements, bc->inputs) != 0) {
+        fprintf(stderr, "Not enough memory for %s at size %zu, skipping.\n", bc->name, elements);
+        continue;
+      }
+
+      /*
+        Efficiency is relative to one thread, measured apart when the list doesn't start
+        at 1. Cases that don't take a thread count run once and have no efficiency.
+      */
+      double single = 0;
+      if (bc->threaded && threads[0] != 1) {
+        size_t reps;
+        single = measure(bc, &ctx, 1, min_time, &reps);
+      }
+      for (size_t t = 0; t < n_thread_counts; t++) {
+        if (!bc->threaded && t > 0) break;
+        size_t n_threads = bc->threaded ? threads[t] : 1;
+        size_t reps;
+        double seconds = measure(bc, &ctx, n_threads, min_time, &reps);
+        if (single == 0) single = seconds;
+        double ns_per_element = seconds * 1e9 / elements;
+        double gb_per_s = bc->bytes_per_element * elements / seconds / 1e9;
+        double efficiency = single / (seconds * n_threads);
+
+        char efficiency_text[32] = "-", efficiency_json[32] = "null";
+        if (bc->threaded) {
+          snprintf(efficiency_text, sizeof(efficiency_text), "%.3f", efficiency);
+          snprintf(efficiency_json, sizeof(efficiency_json), "%.6g", efficiency);
+        }
+        fprintf(table, "%-26s %12zu %8zu %8zu %14.3f %10.3f %10s\n",
+                bc->name, elements, n_threads, reps, ns_per_element, gb_per_s, efficiency_text);
+        if (json != NULL) {
+          fprintf(json, "%s\n    {\"function\": \"%s\", \"size\": %zu, \"threads\": %zu, \"reps\": %zu, "
+                  "\"seconds\": %.9g, \"ns_per_element\": %.6g, \"gb_per_s\": %.6g, \"efficiency\": %s}",
+                  first_result ? "" : ",", bc->name, elements, n_threads, reps, seconds, ns_per_element, gb_per_s,
+                  efficiency_json);
+          first_result = 0;
+        }
+      }
+      destroy_ctx(&ctx);
+    }
+  }
+
+  if (json != NULL) {
+    fprintf(json, "\n  ]\n}\n");
+    if (!json_stdout) fclose(json);
+  }
+  return EXIT_SUCCESS;
+}
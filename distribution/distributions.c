@@ -1,4 +1,6 @@
 #include "../amath.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
 #include <stdio.h>
 #include <math.h>
 #include <pthread.h>
@@ -19,26 +21,29 @@ void *calculation_segment(void *data) {
   double *d = segment->data;
   double *normalized_data = segment->normalized_data;
   double norm_factor = segment->normalization_factor, avg = segment->avg, squared_dev = segment->squared_dev;
+  PROFILE_MARK(chunk_start);
 
   for (size_t i = lim_a; i < lim_b; i++) {
     normalized_data[i] = calculate_ndist_point(d[i], norm_factor, avg, squared_dev);
   }
+  PROFILE_CHUNK(PROFILE_NDIST, chunk_start);
   return NULL;
 }
 
 double *amath_ndist(double *data, size_t n_elements, size_t n_threads) {
   if (data == NULL || n_elements == 0 || n_threads == 0) return NULL;
+  PROFILE_BEGIN(scope);
 
-  double *ndata;
-  if (posix_memalign((void **)&ndata, 64, sizeof(double) * n_elements) != 0) {
-    return NULL;
-  }
+  PROFILE_MARK(alloc_start);
+  double *ndata = memory_alloc(sizeof(double) * n_elements);
+  if (ndata == NULL) return NULL;
 
   struct calc_segment *temp_data;
   if (posix_memalign((void **)&temp_data, 64, sizeof(struct calc_segment) * n_threads) != 0) {
     free(ndata);
     return NULL;
   }
+  PROFILE_PHASE(PROFILE_NDIST, PROFILE_PHASE_ALLOC, alloc_start);
 
   double avg = amath_mean(data, n_elements);
   double deviation = amath_stdev(data, 1, n_elements);
@@ -49,7 +54,10 @@ double *amath_ndist(double *data, size_t n_elements, size_t n_threads) {
 
   pthread_t threads[num_threads];
   size_t step = n_elements / num_threads;
+  size_t created = 0;
+  int status = 0;
 
+  PROFILE_MARK(spawn_start);
   for (size_t i = 0; i < num_threads; i++) {
     temp_data[i].avg = avg;
     temp_data[i].data = data;
@@ -64,18 +72,25 @@ double *amath_ndist(double *data, size_t n_elements, size_t n_threads) {
       temp_data[i].interval_b = n_elements;
     }
 
-    if (pthread_create(&threads[i], NULL, calculation_segment, &temp_data[i]) != 0) {
-      free(ndata);
-      free(temp_data);
-      return NULL;
+    if (memory_thread_create(&threads[i], calculation_segment, &temp_data[i]) != 0) {
+      status = -1;
+      break;
     }
+    created++;
   }
+  PROFILE_PHASE(PROFILE_NDIST, PROFILE_PHASE_SPAWN, spawn_start);
 
-  for (size_t i = 0; i < num_threads; i++) {
+  for (size_t i = 0; i < created; i++) {
     pthread_join(threads[i], NULL);
   }
+  if (status != 0) {
+    free(ndata);
+    free(temp_data);
+    return NULL;
+  }
 
   free(temp_data);
+  PROFILE_CALL(scope, PROFILE_NDIST, sizeof(double) * n_elements * 2);
   return ndata;
 }
 
@@ -93,20 +108,22 @@ void *calculate_pdist_segment(void *data) {
   size_t interval_a = segment->interval_a, interval_b = segment->interval_b;
   double lambda = segment->lambda;
   int *d = segment->data;
+  PROFILE_MARK(chunk_start);
 
   for (size_t i = interval_a; i < interval_b; i++) {
     segment->pdist[i] = calculate_pdist_point(d[i], lambda);
   }
+  PROFILE_CHUNK(PROFILE_PDIST, chunk_start);
   return NULL;
 }
 
 double *amath_pdist(int *data, double lambda, size_t n_elements, size_t n_threads) {
   if (data == NULL || n_elements == 0 || n_threads == 0) return NULL;
+  PROFILE_BEGIN(scope);
 
-  double *pdist;
-  if (posix_memalign((void **)&pdist, 64, sizeof(double) * n_elements) != 0) {
-    return NULL;
-  }
+  PROFILE_MARK(alloc_start);
+  double *pdist = memory_alloc(sizeof(double) * n_elements);
+  if (pdist == NULL) return NULL;
 
   size_t num_threads = n_threads <= n_elements ? n_threads : n_elements;
 
@@ -116,9 +133,13 @@ double *amath_pdist(int *data, double lambda, size_t n_elements, size_t n_thread
     free(pdist);
     return NULL;
   }
+  PROFILE_PHASE(PROFILE_PDIST, PROFILE_PHASE_ALLOC, alloc_start);
 
   size_t step = n_elements / num_threads;
+  size_t created = 0;
+  int status = 0;
 
+  PROFILE_MARK(spawn_start);
   for (size_t i = 0; i < num_threads; i++) {
     segments[i].data = data;
     segments[i].lambda = lambda;
@@ -131,17 +152,24 @@ double *amath_pdist(int *data, double lambda, size_t n_elements, size_t n_thread
       segments[i].interval_b = n_elements;
     }
 
-    if (pthread_create(&threads[i], NULL, calculate_pdist_segment, &segments[i]) != 0) {
-      free(pdist);
-      free(segments);
-      return NULL;
+    if (memory_thread_create(&threads[i], calculate_pdist_segment, &segments[i]) != 0) {
+      status = -1;
+      break;
     }
+    created++;
   }
+  PROFILE_PHASE(PROFILE_PDIST, PROFILE_PHASE_SPAWN, spawn_start);
 
-  for (size_t i = 0; i < num_threads; i++) {
+  for (size_t i = 0; i < created; i++) {
     pthread_join(threads[i], NULL);
   }
+  if (status != 0) {
+    free(pdist);
+    free(segments);
+    return NULL;
+  }
 
   free(segments);
+  PROFILE_CALL(scope, PROFILE_PDIST, (sizeof(int) + sizeof(double)) * n_elements);
   return pdist;
 }
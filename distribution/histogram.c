@@ -0,0 +1,267 @@
+#include "../amath.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Values are binned in blocks: a branch-free loop computes the slot of BIN_BLOCK
+  values at once, which the compiler vectorises for fixed-width bins, then the
+  slots are counted into COUNT_LANES interleaved copies of the counters so that
+  runs of equal slots don't serialise on the same memory location. Every thread
+  counts into its own copies, which it zeroes itself so they are placed near it,
+  and which are added to the histogram at the end.
+*/
+#define BIN_BLOCK 256
+#define COUNT_LANES 4
+/* Extra slots after the bins: values below, above and outside (NaN) the range. */
+#define EXTRA_SLOTS 3
+/* Minimum number of values per thread before the binning is split. */
+#define PARALLEL_BIN_MIN 32768
+
+struct histogram_segment {
+  const Histogram *histogram;
+  const double *data;
+  size_t *counts;
+  size_t index_start, index_end;
+};
+
+static void uniform_slots(const Histogram *h, const double *data, size_t n, uint32_t *slots) {
+  double min = h->edges[0], max = h->edges[h->n_bins];
+  double scale = h->n_bins / (max - min), last = h->n_bins - 1;
+  uint32_t under = h->n_bins, over = h->n_bins + 1, ignored = h->n_bins + 2;
+
+  for (size_t i = 0; i < n; i++) {
+    double x = data[i];
+    double t = (x - min) * scale;
+    t = t > 0 ? t : 0;
+    t = t < last ? t : last;
+    uint32_t bin = (uint32_t)t;
+    slots[i] = x >= min && x <= max ? bin : x < min ? under : x > max ? over : ignored;
+  }
+}
+
+/* Bin i holds edges[i] <= x < edges[i + 1], the last bin also x == edges[n_bins]. */
+static void edge_slots(const Histogram *h, const double *data, size_t n, uint32_t *slots) {
+  const double *edges = h->edges;
+  size_t n_bins = h->n_bins;
+
+  for (size_t i = 0; i < n; i++) {
+    double x = data[i];
+    if (x >= edges[0] && x <= edges[n_bins]) {
+      size_t lo = 0, hi = n_bins;
+      while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (edges[mid] <= x) {
+          lo = mid;
+        } else {
+          hi = mid;
+        }
+      }
+      slots[i] = lo;
+    } else {
+      slots[i] = x < edges[0] ? n_bins : x > edges[n_bins] ? n_bins + 1 : n_bins + 2;
+    }
+  }
+}
+
+static void *histogram_segment_worker(void *arg) {
+  struct histogram_segment *s = (struct histogram_segment *)arg;
+  const Histogram *h = s->histogram;
+  size_t stride = h->n_bins + EXTRA_SLOTS;
+  PROFILE_MARK(chunk_start);
+
+  memset(s->counts, 0, sizeof(size_t) * COUNT_LANES * stride);
+  uint32_t slots[BIN_BLOCK];
+  for (size_t start = s->index_start; start < s->index_end; start += BIN_BLOCK) {
+    size_t n = s->index_end - start < BIN_BLOCK ? s->index_end - start : BIN_BLOCK;
+    if (h->uniform) {
+      uniform_slots(h, s->data + start, n, slots);
+    } else {
+      edge_slots(h, s->data + start, n, slots);
+    }
+    for (size_t i = 0; i < n; i++) {
+      s->counts[(i % COUNT_LANES) * stride + slots[i]]++;
+    }
+  }
+
+  PROFILE_CHUNK(PROFILE_HISTOGRAM, chunk_start);
+  return NULL;
+}
+
+/* Bins the n_elements of data into h, adding to its current counts. */
+static int bin_values(Histogram *h, const double *data, size_t n_elements, size_t n_threads) {
+  size_t num_threads = n_threads < n_elements / PARALLEL_BIN_MIN ? n_threads : n_elements / PARALLEL_BIN_MIN;
+  if (num_threads == 0) num_threads = 1;
+  size_t stride = h->n_bins + EXTRA_SLOTS;
+
+  PROFILE_MARK(alloc_start);
+  size_t *counts = memory_alloc(sizeof(size_t) * num_threads * COUNT_LANES * stride);
+  struct histogram_segment *segments;
+  if (counts == NULL ||
+      posix_memalign((void **)&segments, 64, sizeof(struct histogram_segment) * num_threads) != 0) {
+    free(counts);
+    return -1;
+  }
+  PROFILE_PHASE(PROFILE_HISTOGRAM, PROFILE_PHASE_ALLOC, alloc_start);
+
+  pthread_t threads[num_threads];
+  size_t step = n_elements / num_threads;
+  size_t remaining = n_elements % num_threads;
+  size_t position = 0, created = 0;
+  int status = 0;
+
+  PROFILE_MARK(spawn_start);
+  for (; created < num_threads; created++) {
+    segments[created] = (struct histogram_segment){
+      .histogram = h, .data = data, .counts = counts + created * COUNT_LANES * stride,
+      .index_start = position, .index_end = position + step + (created < remaining ? 1 : 0)
+    };
+    position = segments[created].index_end;
+
+    if (memory_thread_create(&threads[created], histogram_segment_worker, &segments[created]) != 0) {
+      status = -1;
+      break;
+    }
+  }
+  PROFILE_PHASE(PROFILE_HISTOGRAM, PROFILE_PHASE_SPAWN, spawn_start);
+
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  if (status == 0) {
+    for (size_t copy = 0; copy < num_threads * COUNT_LANES; copy++) {
+      const size_t *local = counts + copy * stride;
+      for (size_t b = 0; b < h->n_bins; b++) h->counts[b] += local[b];
+      h->underflow += local[h->n_bins];
+      h->overflow += local[h->n_bins + 1];
+    }
+  }
+
+  free(counts);
+  free(segments);
+  return status;
+}
+
+static Histogram *create_histogram(size_t n_bins, int uniform) {
+  Histogram *h = malloc(sizeof(Histogram));
+  if (h == NULL) return NULL;
+  h->n_bins = n_bins;
+  h->underflow = 0;
+  h->overflow = 0;
+  h->uniform = uniform;
+  h->edges = malloc(sizeof(double) * (n_bins + 1));
+  h->counts = calloc(n_bins, sizeof(size_t));
+  if (h->edges == NULL || h->counts == NULL) {
+    amath_destroy_histogram(h);
+    return NULL;
+  }
+  return h;
+}
+
+/* Range of the values of data that are not NaN. Returns 0 if every value is NaN. */
+static int value_range(const double *data, size_t n_elements, double *min, double *max) {
+  size_t i = 0;
+  while (i < n_elements && isnan(data[i])) i++;
+  if (i == n_elements) return 0;
+  *min = *max = data[i];
+  for (; i < n_elements; i++) {
+    if (data[i] < *min) *min = data[i];
+    if (data[i] > *max) *max = data[i];
+  }
+  return 1;
+}
+
+Histogram *amath_histogram(double *data, size_t n_elements, size_t n_bins, double min, double max,
+                           size_t n_threads) {
+  if (data == NULL || n_elements == 0 || n_bins == 0 || n_bins > UINT32_MAX - EXTRA_SLOTS || n_threads == 0) {
+    return NULL;
+  }
+  PROFILE_BEGIN(scope);
+
+  if (!(min < max)) {
+    if (!value_range(data, n_elements, &min, &max)) return NULL;
+    /* A constant series still gets a range one unit wide around its value. */
+    if (min == max) {
+      min -= 0.5;
+      max += 0.5;
+    }
+  }
+  if (!isfinite(min) || !isfinite(max)) return NULL;
+
+  Histogram *h = create_histogram(n_bins, 1);
+  if (h == NULL) return NULL;
+  double width = (max - min) / n_bins;
+  for (size_t i = 0; i < n_bins; i++) h->edges[i] = min + i * width;
+  h->edges[n_bins] = max;
+
+  if (bin_values(h, data, n_elements, n_threads) != 0) {
+    amath_destroy_histogram(h);
+    return NULL;
+  }
+  PROFILE_CALL(scope, PROFILE_HISTOGRAM, sizeof(double) * n_elements);
+  return h;
+}
+
+Histogram *amath_histogram_quantile(double *data, size_t n_elements, size_t n_bins, size_t n_threads) {
+  if (data == NULL || n_elements == 0 || n_bins == 0 || n_bins > UINT32_MAX - EXTRA_SLOTS || n_threads == 0) {
+    return NULL;
+  }
+  PROFILE_BEGIN(scope);
+
+  double *sorted = malloc(sizeof(double) * n_elements);
+  if (sorted == NULL) return NULL;
+  memcpy(sorted, data, sizeof(double) * n_elements);
+  if (amath_sort(sorted, n_elements, n_threads) != 0) {
+    free(sorted);
+    return NULL;
+  }
+
+  /* NaNs are sorted last and take no part in the quantiles. */
+  size_t n_values = n_elements;
+  while (n_values > 0 && isnan(sorted[n_values - 1])) n_values--;
+
+  Histogram *h = n_values > 0 ? create_histogram(n_bins, 0) : NULL;
+  if (h == NULL) {
+    free(sorted);
+    return NULL;
+  }
+
+  /* Edge i is the quantile i / n_bins, interpolated linearly between order statistics. */
+  for (size_t i = 0; i <= n_bins; i++) {
+    double position = (double)i * (n_values - 1) / n_bins;
+    size_t below = (size_t)position;
+    double fraction = position - below;
+    h->edges[i] = below + 1 < n_values ? sorted[below] + fraction * (sorted[below + 1] - sorted[below])
+                                       : sorted[below];
+  }
+  free(sorted);
+
+  if (bin_values(h, data, n_elements, n_threads) != 0) {
+    amath_destroy_histogram(h);
+    return NULL;
+  }
+  PROFILE_CALL(scope, PROFILE_HISTOGRAM, sizeof(double) * n_elements * 2);
+  return h;
+}
+
+int amath_histogram_update(Histogram *histogram, double *data, size_t n_elements, size_t n_threads) {
+  if (histogram == NULL || data == NULL || n_threads == 0) return -1;
+  if (n_elements == 0) return 0;
+  PROFILE_BEGIN(scope);
+
+  int status = bin_values(histogram, data, n_elements, n_threads);
+  PROFILE_CALL(scope, PROFILE_HISTOGRAM, sizeof(double) * n_elements);
+  return status;
+}
+
+void amath_destroy_histogram(Histogram *histogram) {
+  if (histogram == NULL) return;
+  free(histogram->edges);
+  free(histogram->counts);
+  free(histogram);
+}
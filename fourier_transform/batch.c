@@ -0,0 +1,220 @@
+#include "../amath.h"
+#include "fft.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Number of transforms computed side by side. Transforms are gathered into split
+  real/imaginary buffers laid out as buffer[j * DFT_LANES + lane], so every butterfly
+  operates on DFT_LANES contiguous doubles and the lane loop vectorises.
+*/
+#define DFT_LANES 8
+
+struct batch_segment {
+  double complex *data;
+  size_t size, stride, dist;
+  size_t index_start, index_end;
+  const double complex *twiddles;
+  double *buffer;
+  int inverse;
+};
+
+static void bit_reverse_lanes(double *re, double *im, size_t n) {
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      for (size_t t = 0; t < DFT_LANES; t++) {
+        double temp_re = re[i * DFT_LANES + t], temp_im = im[i * DFT_LANES + t];
+        re[i * DFT_LANES + t] = re[j * DFT_LANES + t];
+        im[i * DFT_LANES + t] = im[j * DFT_LANES + t];
+        re[j * DFT_LANES + t] = temp_re;
+        im[j * DFT_LANES + t] = temp_im;
+      }
+    }
+  }
+}
+
+static void fft_lanes(double *restrict re, double *restrict im, size_t n, const double complex *twiddles, int inverse) {
+  bit_reverse_lanes(re, im, n);
+
+  for (size_t len = 2; len <= n; len <<= 1) {
+    size_t half = len >> 1;
+    size_t tw_step = n / len;
+    for (size_t start = 0; start < n; start += len) {
+      for (size_t k = 0; k < half; k++) {
+        double wr = creal(twiddles[k * tw_step]);
+        double wi = inverse ? -cimag(twiddles[k * tw_step]) : cimag(twiddles[k * tw_step]);
+        double *restrict er = re + (start + k) * DFT_LANES, *restrict ei = im + (start + k) * DFT_LANES;
+        double *restrict or = re + (start + k + half) * DFT_LANES, *restrict oi = im + (start + k + half) * DFT_LANES;
+        for (size_t t = 0; t < DFT_LANES; t++) {
+          double xr = or[t] * wr - oi[t] * wi;
+          double xi = or[t] * wi + oi[t] * wr;
+          or[t] = er[t] - xr;
+          oi[t] = ei[t] - xi;
+          er[t] += xr;
+          ei[t] += xi;
+        }
+      }
+    }
+  }
+}
+
+/*
+  Direct transform for sizes that are not a power of two. twiddles holds all n
+  factors exp(-2*pi*i*k/n); the index (k * j) mod n is advanced incrementally.
+*/
+static void dft_lanes(const double *restrict re, const double *restrict im, double *restrict out_re,
+                      double *restrict out_im, size_t n, const double complex *twiddles, int inverse) {
+  for (size_t k = 0; k < n; k++) {
+    double acc_re[DFT_LANES] = {0}, acc_im[DFT_LANES] = {0};
+    size_t index = 0;
+    for (size_t j = 0; j < n; j++) {
+      double wr = creal(twiddles[index]);
+      double wi = inverse ? -cimag(twiddles[index]) : cimag(twiddles[index]);
+      for (size_t t = 0; t < DFT_LANES; t++) {
+        acc_re[t] += re[j * DFT_LANES + t] * wr - im[j * DFT_LANES + t] * wi;
+        acc_im[t] += re[j * DFT_LANES + t] * wi + im[j * DFT_LANES + t] * wr;
+      }
+      index += k;
+      if (index >= n) index -= n;
+    }
+    memcpy(out_re + k * DFT_LANES, acc_re, sizeof(acc_re));
+    memcpy(out_im + k * DFT_LANES, acc_im, sizeof(acc_im));
+  }
+}
+
+static void *batch_segment_worker(void *arg) {
+  struct batch_segment *s = (struct batch_segment *)arg;
+  size_t n = s->size;
+  int pow2 = fft_is_pow2(n);
+  PROFILE_MARK(chunk_start);
+
+  double *re = s->buffer;
+  double *im = re + n * DFT_LANES;
+  double *out_re = pow2 ? re : im + n * DFT_LANES;
+  double *out_im = pow2 ? im : out_re + n * DFT_LANES;
+  double scale = s->inverse ? 1.0 / n : 1.0;
+
+  for (size_t first = s->index_start; first < s->index_end; first += DFT_LANES) {
+    size_t lanes = s->index_end - first < DFT_LANES ? s->index_end - first : DFT_LANES;
+
+    for (size_t j = 0; j < n; j++) {
+      for (size_t t = 0; t < DFT_LANES; t++) {
+        double complex x = t < lanes ? s->data[(first + t) * s->dist + j * s->stride] : 0.0;
+        re[j * DFT_LANES + t] = creal(x);
+        im[j * DFT_LANES + t] = cimag(x);
+      }
+    }
+
+    if (pow2) {
+      fft_lanes(re, im, n, s->twiddles, s->inverse);
+    } else {
+      dft_lanes(re, im, out_re, out_im, n, s->twiddles, s->inverse);
+    }
+
+    for (size_t t = 0; t < lanes; t++) {
+      double complex *transform = s->data + (first + t) * s->dist;
+      for (size_t j = 0; j < n; j++) {
+        transform[j * s->stride] = CMPLX(out_re[j * DFT_LANES + t] * scale, out_im[j * DFT_LANES + t] * scale);
+      }
+    }
+  }
+
+  PROFILE_CHUNK(s->inverse ? PROFILE_INVERSE_DFT_MANY : PROFILE_DFT_MANY, chunk_start);
+  return NULL;
+}
+
+/*
+  Returns 1 if no element belongs to two transforms: either every transform ends before
+  the next one starts, or the transforms are interleaved within one stride.
+*/
+static int disjoint_layout(size_t size, size_t howmany, size_t stride, size_t dist) {
+  if (howmany == 1) return 1;
+  if (dist == 0) return 0;
+  /* dist > (size - 1) * stride and stride > (howmany - 1) * dist, without overflowing. */
+  return size - 1 <= (dist - 1) / stride || howmany - 1 <= (stride - 1) / dist;
+}
+
+static int dft_many(double complex *data, size_t size, size_t howmany, size_t stride, size_t dist,
+                    size_t n_threads, int inverse) {
+  if (data == NULL || size == 0 || howmany == 0 || stride == 0 || n_threads == 0) return -1;
+  if (!disjoint_layout(size, howmany, stride, dist)) return -1;
+  PROFILE_BEGIN(scope);
+
+  double complex *twiddles = fft_any_twiddles(size);
+  if (twiddles == NULL) return -1;
+
+  /* Whole groups of DFT_LANES transforms are handed to each thread. */
+  size_t groups = (howmany + DFT_LANES - 1) / DFT_LANES;
+  size_t num_threads = n_threads <= groups ? n_threads : groups;
+
+  /* Lane buffers are allocated up front, so once a transform starts nothing can fail. */
+  size_t lane_doubles = size * DFT_LANES * (fft_is_pow2(size) ? 2 : 4);
+  struct batch_segment *segments;
+  if (posix_memalign((void **)&segments, 64, sizeof(struct batch_segment) * num_threads) != 0) {
+    free(twiddles);
+    return -1;
+  }
+  double *buffers = memory_alloc(sizeof(double) * lane_doubles * num_threads);
+  if (buffers == NULL) {
+    free(segments);
+    free(twiddles);
+    return -1;
+  }
+
+  pthread_t threads[num_threads];
+  size_t step = groups / num_threads;
+  size_t remaining = groups % num_threads;
+  size_t position = 0, created = 0;
+
+  /*
+    A segment whose thread can't be created is transformed by the calling thread
+    instead, so the data is never left partly transformed.
+  */
+  PROFILE_MARK(spawn_start);
+  for (size_t i = 0; i < num_threads; i++) {
+    size_t count = (step + (i < remaining ? 1 : 0)) * DFT_LANES;
+    segments[i].data = data;
+    segments[i].size = size;
+    segments[i].stride = stride;
+    segments[i].dist = dist;
+    segments[i].index_start = position;
+    segments[i].index_end = position + count < howmany ? position + count : howmany;
+    segments[i].twiddles = twiddles;
+    segments[i].buffer = buffers + i * lane_doubles;
+    segments[i].inverse = inverse;
+    position = segments[i].index_end;
+
+    if (memory_thread_create(&threads[created], batch_segment_worker, &segments[i]) == 0) {
+      created++;
+    } else {
+      batch_segment_worker(&segments[i]);
+    }
+  }
+  PROFILE_PHASE(inverse ? PROFILE_INVERSE_DFT_MANY : PROFILE_DFT_MANY, PROFILE_PHASE_SPAWN, spawn_start);
+
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(buffers);
+  free(segments);
+  free(twiddles);
+  PROFILE_CALL(scope, inverse ? PROFILE_INVERSE_DFT_MANY : PROFILE_DFT_MANY, sizeof(double complex) * size * howmany * 2);
+  return 0;
+}
+
+int amath_dft_many(double complex *data, size_t size, size_t howmany, size_t stride, size_t dist, size_t n_threads) {
+  return dft_many(data, size, howmany, stride, dist, n_threads, 0);
+}
+
+int amath_inverse_dft_many(double complex *data, size_t size, size_t howmany, size_t stride, size_t dist,
+                           size_t n_threads) {
+  return dft_many(data, size, howmany, stride, dist, n_threads, 1);
+}
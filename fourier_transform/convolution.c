@@ -0,0 +1,287 @@
+#include "../amath.h"
+#include "fft.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+  Kernels up to DIRECT_KERNEL_LIMIT samples are always convolved directly. Above it,
+  the estimated FFT work is weighted by FFT_COST_FACTOR (a butterfly is dearer than
+  the multiply-add of the direct loop) and compared with the direct work.
+*/
+#define DIRECT_KERNEL_LIMIT 16
+#define FFT_COST_FACTOR 1.5
+
+struct conv_segment {
+  const double *x, *h;
+  size_t n, m;
+  double *result;
+  size_t out_start, out_len;
+  size_t index_start, index_end;
+  const double complex *spectrum, *twiddles;
+  size_t fft_size;
+  int status;
+};
+
+static void *direct_segment(void *arg) {
+  struct conv_segment *s = (struct conv_segment *)arg;
+  const double *x = s->x, *h = s->h;
+  size_t n = s->n, m = s->m;
+  PROFILE_MARK(chunk_start);
+
+  for (size_t i = s->index_start; i < s->index_end; i++) {
+    size_t k = s->out_start + i;
+    size_t j_start = k >= n ? k - n + 1 : 0;
+    size_t j_end = k < m ? k + 1 : m;
+    double total = 0;
+    for (size_t j = j_start; j < j_end; j++) {
+      total += h[j] * x[k - j];
+    }
+    s->result[i] = total;
+  }
+  PROFILE_CHUNK(PROFILE_CONVOLVE, chunk_start);
+  return NULL;
+}
+
+#define sample(x, n, i) (((i) >= 0 && (size_t)(i) < (n)) ? (x)[(i)] : 0.0)
+
+/*
+  Overlap-save over the blocks [index_start, index_end). Two consecutive blocks are
+  packed into the real and imaginary parts of one complex buffer: the kernel is real,
+  so the real and imaginary parts of the product stay independent convolutions.
+*/
+static void *overlap_save_segment(void *arg) {
+  struct conv_segment *s = (struct conv_segment *)arg;
+  size_t size = s->fft_size, m = s->m, n = s->n;
+  size_t step = size - m + 1;
+  const double complex *spectrum = s->spectrum;
+  PROFILE_MARK(chunk_start);
+
+  double complex *buffer;
+  if (posix_memalign((void **)&buffer, 64, sizeof(double complex) * size) != 0) {
+    s->status = -1;
+    return NULL;
+  }
+
+  for (size_t b = s->index_start; b < s->index_end; b += 2) {
+    int pair = b + 1 < s->index_end;
+    ptrdiff_t base = (ptrdiff_t)(s->out_start + b * step) - (ptrdiff_t)(m - 1);
+    ptrdiff_t next = base + (ptrdiff_t)step;
+
+    for (size_t t = 0; t < size; t++) {
+      ptrdiff_t i = base + (ptrdiff_t)t, j = next + (ptrdiff_t)t;
+      buffer[t] = CMPLX(sample(s->x, n, i), pair ? sample(s->x, n, j) : 0.0);
+    }
+
+    fft_radix2(buffer, size, s->twiddles, 0);
+    for (size_t k = 0; k < size; k++) {
+      double ar = creal(buffer[k]), ai = cimag(buffer[k]);
+      double br = creal(spectrum[k]), bi = cimag(spectrum[k]);
+      buffer[k] = CMPLX(ar * br - ai * bi, ar * bi + ai * br);
+    }
+    fft_radix2(buffer, size, s->twiddles, 1);
+
+    for (size_t t = m - 1; t < size; t++) {
+      size_t index = b * step + t - (m - 1);
+      if (index < s->out_len) s->result[index] = creal(buffer[t]) / size;
+      if (pair && index + step < s->out_len) s->result[index + step] = cimag(buffer[t]) / size;
+    }
+  }
+
+  free(buffer);
+  PROFILE_CHUNK(PROFILE_CONVOLVE, chunk_start);
+  return NULL;
+}
+
+/*
+  Picks the power of two FFT size with the lowest estimated work per output sample
+  for a kernel of m samples and len outputs. The cost of the choice is stored in cost.
+*/
+static size_t choose_fft_size(size_t m, size_t len, double *cost) {
+  size_t max_size = fft_next_pow2(len + m - 1);
+  size_t size = fft_next_pow2(2 * m);
+  if (size > max_size) size = max_size;
+
+  size_t best = size;
+  *cost = INFINITY;
+  for (;; size <<= 1) {
+    size_t step = size - m + 1;
+    size_t pairs = ((len + step - 1) / step + 1) / 2;
+    double c = pairs * (2.0 * size * log2((double)size) + 4.0 * size);
+    if (c < *cost) {
+      *cost = c;
+      best = size;
+    }
+    if (size >= max_size) break;
+  }
+  return best;
+}
+
+static int run_segments(struct conv_segment *segments, size_t num_threads, void *(*func)(void *)) {
+  pthread_t threads[num_threads];
+  size_t created = 0;
+  int status = 0;
+
+  PROFILE_MARK(spawn_start);
+  for (; created < num_threads; created++) {
+    if (memory_thread_create(&threads[created], func, &segments[created]) != 0) {
+      status = -1;
+      break;
+    }
+  }
+  PROFILE_PHASE(PROFILE_CONVOLVE, PROFILE_PHASE_SPAWN, spawn_start);
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+    if (segments[i].status != 0) status = -1;
+  }
+  return status;
+}
+
+/*
+  Computes the samples [out_start, out_start + len) of the full linear convolution of
+  x (n samples) with h (m samples, m <= n), returning a new array or NULL on error.
+*/
+static double *convolve(const double *x, size_t n, const double *h, size_t m,
+                        size_t out_start, size_t len, size_t n_threads) {
+  double *result;
+  if (posix_memalign((void **)&result, 64, sizeof(double) * len) != 0) {
+    return NULL;
+  }
+
+  double fft_cost = INFINITY;
+  size_t fft_size = m > DIRECT_KERNEL_LIMIT ? choose_fft_size(m, len, &fft_cost) : 0;
+  int use_fft = FFT_COST_FACTOR * fft_cost < (double)len * m;
+
+  size_t units = len;
+  double complex *twiddles = NULL, *spectrum = NULL;
+  if (use_fft) {
+    size_t step = fft_size - m + 1;
+    units = (len + step - 1) / step;
+
+    twiddles = fft_twiddles(fft_size);
+    if (twiddles == NULL || posix_memalign((void **)&spectrum, 64, sizeof(double complex) * fft_size) != 0) {
+      free(twiddles);
+      free(result);
+      return NULL;
+    }
+    for (size_t i = 0; i < fft_size; i++) {
+      spectrum[i] = i < m ? h[i] : 0.0;
+    }
+    fft_radix2(spectrum, fft_size, twiddles, 0);
+  }
+
+  size_t num_threads = n_threads <= units ? n_threads : units;
+  struct conv_segment *segments;
+  if (posix_memalign((void **)&segments, 64, sizeof(struct conv_segment) * num_threads) != 0) {
+    free(twiddles);
+    free(spectrum);
+    free(result);
+    return NULL;
+  }
+
+  /* For the FFT path the work units are blocks, split on even boundaries so pairs stay together. */
+  size_t granularity = use_fft ? 2 : 1;
+  size_t groups = (units + granularity - 1) / granularity;
+  size_t step = groups / num_threads;
+  size_t remaining = groups % num_threads;
+  size_t position = 0;
+
+  for (size_t i = 0; i < num_threads; i++) {
+    size_t count = (step + (i < remaining ? 1 : 0)) * granularity;
+    segments[i].x = x;
+    segments[i].h = h;
+    segments[i].n = n;
+    segments[i].m = m;
+    segments[i].result = result;
+    segments[i].out_start = out_start;
+    segments[i].out_len = len;
+    segments[i].index_start = position;
+    segments[i].index_end = position + count < units ? position + count : units;
+    segments[i].spectrum = spectrum;
+    segments[i].twiddles = twiddles;
+    segments[i].fft_size = fft_size;
+    segments[i].status = 0;
+    position = segments[i].index_end;
+  }
+
+  int status = run_segments(segments, num_threads, use_fft ? overlap_save_segment : direct_segment);
+
+  free(segments);
+  free(twiddles);
+  free(spectrum);
+  if (status != 0) {
+    free(result);
+    return NULL;
+  }
+  return result;
+}
+
+/*
+  Maps a convolution mode to the range of full-convolution samples it returns. SAME
+  keeps n samples centred on the full result, as scipy does, and VALID needs m <= n.
+  Returns -1 if the mode is invalid for the sizes.
+*/
+static int output_range(size_t n, size_t m, ConvolutionMode mode, size_t *start, size_t *len) {
+  switch (mode) {
+    case AMATH_CONV_FULL:
+      *start = 0;
+      *len = n + m - 1;
+      return 0;
+    case AMATH_CONV_SAME:
+      *start = (m - 1) / 2;
+      *len = n;
+      return 0;
+    case AMATH_CONV_VALID:
+      if (m > n) return -1;
+      *start = m - 1;
+      *len = n - m + 1;
+      return 0;
+  }
+  return -1;
+}
+
+/* amath_convolve without the profiling hooks, so amath_xcorr is only counted once. */
+static double *convolve_mode(const double *signal, size_t n_signal, const double *kernel, size_t n_kernel,
+                             ConvolutionMode mode, size_t n_threads, size_t *n_result) {
+  size_t start, len;
+  if (output_range(n_signal, n_kernel, mode, &start, &len) != 0) return NULL;
+
+  double *result = n_signal >= n_kernel
+    ? convolve(signal, n_signal, kernel, n_kernel, start, len, n_threads)
+    : convolve(kernel, n_kernel, signal, n_signal, start, len, n_threads);
+
+  if (result != NULL && n_result != NULL) *n_result = len;
+  return result;
+}
+
+double *amath_convolve(double *signal, size_t n_signal, double *kernel, size_t n_kernel,
+                       ConvolutionMode mode, size_t n_threads, size_t *n_result) {
+  if (signal == NULL || kernel == NULL || n_signal == 0 || n_kernel == 0 || n_threads == 0) return NULL;
+  PROFILE_BEGIN(scope);
+
+  size_t len = 0;
+  double *result = convolve_mode(signal, n_signal, kernel, n_kernel, mode, n_threads, &len);
+  if (result != NULL && n_result != NULL) *n_result = len;
+  PROFILE_CALL(scope, PROFILE_CONVOLVE, sizeof(double) * (n_signal + n_kernel + len));
+  return result;
+}
+
+double *amath_xcorr(double *data1, size_t n1, double *data2, size_t n2,
+                    ConvolutionMode mode, size_t n_threads, size_t *n_result) {
+  if (data1 == NULL || data2 == NULL || n1 == 0 || n2 == 0 || n_threads == 0) return NULL;
+  PROFILE_BEGIN(scope);
+
+  double *reversed = malloc(sizeof(double) * n2);
+  if (reversed == NULL) return NULL;
+  for (size_t i = 0; i < n2; i++) {
+    reversed[i] = data2[n2 - 1 - i];
+  }
+
+  double *result = convolve_mode(data1, n1, reversed, n2, mode, n_threads, n_result);
+  free(reversed);
+  PROFILE_CALL(scope, PROFILE_XCORR, sizeof(double) * (n1 + n2));
+  return result;
+}
@@ -1,4 +1,6 @@
 #include "../amath.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
 #include <pthread.h>
 #include <math.h>
 #include <complex.h>
@@ -21,6 +23,7 @@ static void *calc_xn(void *arg) {
   size_t start = temp->index_start;
   size_t end = temp->index_end;
   size_t size = temp->size;
+  PROFILE_MARK(chunk_start);
 
   for (size_t k = start; k < end; k++) {
     double complex total = 0;
@@ -29,6 +32,7 @@ static void *calc_xn(void *arg) {
     }
     transform[k] = total;
   }
+  PROFILE_CHUNK(PROFILE_DFT, chunk_start);
   return NULL;
 }
 
@@ -36,22 +40,26 @@ int amath_dft(double complex *data, size_t size, size_t n_threads) {
   if (data == NULL || size == 0 || n_threads == 0) {
     return -1;
   }
+  PROFILE_BEGIN(scope);
 
-  double complex *transform;
-  if (posix_memalign((void **)&transform, 64, sizeof(double complex) * size) != 0) {
-    return -1;
-  }
+  PROFILE_MARK(alloc_start);
+  double complex *transform = memory_alloc(sizeof(double complex) * size);
+  if (transform == NULL) return -1;
 
   struct ArrayAndItem *str;
   if (posix_memalign((void **)&str, 64, sizeof(struct ArrayAndItem) * n_threads) != 0) {
     free(transform);
     return -1;
   }
+  PROFILE_PHASE(PROFILE_DFT, PROFILE_PHASE_ALLOC, alloc_start);
 
   pthread_t threads[n_threads];
   size_t step = size / n_threads;
   size_t remaining = size % n_threads;
+  size_t created = 0;
+  int status = 0;
 
+  PROFILE_MARK(spawn_start);
   for (size_t i = 0; i < n_threads; i++) {
     str[i].array = data;
     str[i].transform = transform;
@@ -59,16 +67,22 @@ int amath_dft(double complex *data, size_t size, size_t n_threads) {
     str[i].index_start = i * step;
     str[i].index_end = (i + 1) * step + (i == n_threads - 1 ? remaining : 0);
 
-    if (pthread_create(&threads[i], NULL, calc_xn, &str[i]) != 0) {
-      free(transform);
-      free(str);
-      return -1;
+    if (memory_thread_create(&threads[i], calc_xn, &str[i]) != 0) {
+      status = -1;
+      break;
     }
+    created++;
   }
+  PROFILE_PHASE(PROFILE_DFT, PROFILE_PHASE_SPAWN, spawn_start);
 
-  for (size_t i = 0; i < n_threads; i++) {
+  for (size_t i = 0; i < created; i++) {
     pthread_join(threads[i], NULL);
   }
+  if (status != 0) {
+    free(transform);
+    free(str);
+    return -1;
+  }
 
   for (size_t i = 0; i < size; i++) {
     data[i] = transform[i];
@@ -76,6 +90,7 @@ int amath_dft(double complex *data, size_t size, size_t n_threads) {
 
   free(transform);
   free(str);
+  PROFILE_CALL(scope, PROFILE_DFT, sizeof(double complex) * size);
   return 0;
 }
 
@@ -86,6 +101,7 @@ static void *calc_inverse_xn(void *data) {
   size_t index_start = d->index_start, index_end = d->index_end, size = d->size;
   double complex *arr = d->array;
   double complex *inverse_transform = d->transform;
+  PROFILE_MARK(chunk_start);
 
   for (size_t i = index_start; i < index_end; i++) {
     double complex total = 0;
@@ -94,26 +110,31 @@ static void *calc_inverse_xn(void *data) {
     }
     inverse_transform[i] = total / size;
   }
+  PROFILE_CHUNK(PROFILE_INVERSE_DFT, chunk_start);
   return NULL;
 }
 
 int amath_inverse_dft(double complex *data, size_t size, size_t n_threads) {
   if (data == NULL || size == 0 || n_threads == 0) return -1;
+  PROFILE_BEGIN(scope);
 
-  double complex *inverse_transform;
-  if (posix_memalign((void **)&inverse_transform, 64, sizeof(double complex) * size) != 0) {
-    return -1;
-  }
+  PROFILE_MARK(alloc_start);
+  double complex *inverse_transform = memory_alloc(sizeof(double complex) * size);
+  if (inverse_transform == NULL) return -1;
 
   struct ArrayAndItem *transform;
   if (posix_memalign((void **)&transform, 64, sizeof(struct ArrayAndItem) * n_threads) != 0) {
     free(inverse_transform);
     return -1;
   }
+  PROFILE_PHASE(PROFILE_INVERSE_DFT, PROFILE_PHASE_ALLOC, alloc_start);
 
   pthread_t threads[n_threads];
   size_t step = size / n_threads;
+  size_t created = 0;
+  int status = 0;
 
+  PROFILE_MARK(spawn_start);
   for (size_t i = 0; i < n_threads; i++) {
     transform[i].array = data;
     transform[i].index_start = step * i;
@@ -121,16 +142,22 @@ int amath_inverse_dft(double complex *data, size_t size, size_t n_threads) {
     transform[i].size = size;
     transform[i].transform = inverse_transform;
 
-    if (pthread_create(&threads[i], NULL, calc_inverse_xn, &transform[i]) != 0) {
-      free(inverse_transform);
-      free(transform);
-      return -1;
+    if (memory_thread_create(&threads[i], calc_inverse_xn, &transform[i]) != 0) {
+      status = -1;
+      break;
     }
+    created++;
   }
+  PROFILE_PHASE(PROFILE_INVERSE_DFT, PROFILE_PHASE_SPAWN, spawn_start);
 
-  for (size_t i = 0; i < n_threads; i++) {
+  for (size_t i = 0; i < created; i++) {
     pthread_join(threads[i], NULL);
   }
+  if (status != 0) {
+    free(inverse_transform);
+    free(transform);
+    return -1;
+  }
 
   for (size_t i = 0; i < size; i++) {
     data[i] = inverse_transform[i];
@@ -138,5 +165,6 @@ int amath_inverse_dft(double complex *data, size_t size, size_t n_threads) {
 
   free(inverse_transform);
   free(transform);
+  PROFILE_CALL(scope, PROFILE_INVERSE_DFT, sizeof(double complex) * size);
   return 0;
 }
@@ -0,0 +1,192 @@
+#include "../amath.h"
+#include "fft.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Side of the square tiles the transposes are blocked in (32 x 32 complex = 16 KB). */
+#define TRANSPOSE_BLOCK 32
+
+struct nd_segment {
+  double complex *data, *out;
+  size_t rows, cols;
+  size_t index_start, index_end;
+  const double complex *twiddles;
+  int inverse;
+  int status;
+};
+
+/* Transforms the rows [index_start, index_end) of the rows x cols matrix data. */
+static void *row_pass(void *arg) {
+  struct nd_segment *s = (struct nd_segment *)arg;
+  size_t cols = s->cols;
+  PROFILE_MARK(chunk_start);
+
+  double complex *scratch = NULL;
+  if (!fft_is_pow2(cols) && posix_memalign((void **)&scratch, 64, sizeof(double complex) * cols) != 0) {
+    s->status = -1;
+    return NULL;
+  }
+
+  double scale = 1.0 / cols;
+  for (size_t r = s->index_start; r < s->index_end; r++) {
+    double complex *row = s->data + r * cols;
+    fft_transform(row, cols, s->twiddles, scratch, s->inverse);
+    if (s->inverse) {
+      for (size_t c = 0; c < cols; c++) row[c] *= scale;
+    }
+  }
+
+  free(scratch);
+  PROFILE_CHUNK(PROFILE_DFTND, chunk_start);
+  return NULL;
+}
+
+/*
+  Writes the transpose of the row blocks [index_start, index_end) of the rows x cols
+  matrix data into the cols x rows matrix out, one TRANSPOSE_BLOCK square tile at a time.
+*/
+static void *transpose_pass(void *arg) {
+  struct nd_segment *s = (struct nd_segment *)arg;
+  size_t rows = s->rows, cols = s->cols;
+  size_t row_end = s->index_end * TRANSPOSE_BLOCK < rows ? s->index_end * TRANSPOSE_BLOCK : rows;
+  PROFILE_MARK(chunk_start);
+
+  for (size_t rb = s->index_start * TRANSPOSE_BLOCK; rb < row_end; rb += TRANSPOSE_BLOCK) {
+    size_t r_end = rb + TRANSPOSE_BLOCK < rows ? rb + TRANSPOSE_BLOCK : rows;
+    for (size_t cb = 0; cb < cols; cb += TRANSPOSE_BLOCK) {
+      size_t c_end = cb + TRANSPOSE_BLOCK < cols ? cb + TRANSPOSE_BLOCK : cols;
+      for (size_t r = rb; r < r_end; r++) {
+        for (size_t c = cb; c < c_end; c++) {
+          s->out[c * rows + r] = s->data[r * cols + c];
+        }
+      }
+    }
+  }
+
+  PROFILE_CHUNK(PROFILE_DFTND, chunk_start);
+  return NULL;
+}
+
+static int run_pass(void *(*func)(void *), const struct nd_segment *base, size_t units, size_t n_threads) {
+  size_t num_threads = n_threads <= units ? n_threads : units;
+  struct nd_segment *segments;
+  if (posix_memalign((void **)&segments, 64, sizeof(struct nd_segment) * num_threads) != 0) {
+    return -1;
+  }
+
+  pthread_t threads[num_threads];
+  size_t step = units / num_threads;
+  size_t remaining = units % num_threads;
+  size_t position = 0, created = 0;
+  int status = 0;
+
+  PROFILE_MARK(spawn_start);
+  for (; created < num_threads; created++) {
+    segments[created] = *base;
+    segments[created].index_start = position;
+    position += step + (created < remaining ? 1 : 0);
+    segments[created].index_end = position;
+
+    if (memory_thread_create(&threads[created], func, &segments[created]) != 0) {
+      status = -1;
+      break;
+    }
+  }
+  PROFILE_PHASE(PROFILE_DFTND, PROFILE_PHASE_SPAWN, spawn_start);
+
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+    if (segments[i].status != 0) status = -1;
+  }
+
+  free(segments);
+  return status;
+}
+
+/*
+  Every pass transforms the contiguous last axis, then transposes the data viewed as a
+  (total / last) x last matrix, which rotates that axis to the front. After one pass per
+  dimension every axis was transformed once and the original layout is restored.
+*/
+static int dft_nd(double complex *data, const size_t *dims, size_t n_dims, size_t n_threads, int inverse) {
+  if (data == NULL || dims == NULL || n_dims == 0 || n_threads == 0) return -1;
+
+  /* The elements, and the bytes of the scratch copy, must be countable in a size_t. */
+  size_t total = 1;
+  for (size_t i = 0; i < n_dims; i++) {
+    if (dims[i] == 0 || dims[i] > SIZE_MAX / sizeof(double complex) / total) return -1;
+    total *= dims[i];
+  }
+  PROFILE_BEGIN(scope);
+
+  PROFILE_MARK(alloc_start);
+  double complex *scratch = NULL;
+  if (n_dims > 1 && posix_memalign((void **)&scratch, 64, sizeof(double complex) * total) != 0) {
+    return -1;
+  }
+  PROFILE_PHASE(PROFILE_DFTND, PROFILE_PHASE_ALLOC, alloc_start);
+
+  double complex *current = data, *other = scratch;
+  double complex *twiddles = NULL;
+  size_t twiddles_size = 0;
+  int status = 0;
+
+  for (size_t i = 0; i < n_dims && status == 0; i++) {
+    size_t len = dims[n_dims - 1 - i];
+    size_t rows = total / len;
+
+    if (len != twiddles_size) {
+      free(twiddles);
+      twiddles = fft_any_twiddles(len);
+      twiddles_size = len;
+      if (twiddles == NULL) {
+        status = -1;
+        break;
+      }
+    }
+
+    struct nd_segment base = {
+      .data = current, .out = other, .rows = rows, .cols = len,
+      .twiddles = twiddles, .inverse = inverse, .status = 0
+    };
+    status = run_pass(row_pass, &base, rows, n_threads);
+
+    /* A 1 x n matrix has the same layout as its transpose. */
+    if (status == 0 && n_dims > 1 && rows > 1 && len > 1) {
+      status = run_pass(transpose_pass, &base, (rows + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK, n_threads);
+      other = current;
+      current = base.out;
+    }
+  }
+
+  if (status == 0 && current != data) {
+    memcpy(data, current, sizeof(double complex) * total);
+  }
+
+  free(twiddles);
+  free(scratch);
+  PROFILE_CALL(scope, PROFILE_DFTND, sizeof(double complex) * total);
+  return status;
+}
+
+int amath_dftnd(double complex *data, const size_t *dims, size_t n_dims, size_t n_threads) {
+  return dft_nd(data, dims, n_dims, n_threads, 0);
+}
+
+int amath_inverse_dftnd(double complex *data, const size_t *dims, size_t n_dims, size_t n_threads) {
+  return dft_nd(data, dims, n_dims, n_threads, 1);
+}
+
+int amath_dft2d(double complex *data, size_t rows, size_t cols, size_t n_threads) {
+  size_t dims[2] = {rows, cols};
+  return dft_nd(data, dims, 2, n_threads, 0);
+}
+
+int amath_inverse_dft2d(double complex *data, size_t rows, size_t cols, size_t n_threads) {
+  size_t dims[2] = {rows, cols};
+  return dft_nd(data, dims, 2, n_threads, 1);
+}
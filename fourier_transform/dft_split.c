@@ -0,0 +1,104 @@
+#include "../amath.h"
+#include "fft.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Runs func on every segment, one thread each. A segment whose thread can't be created
+  is run by the calling thread instead, so a transform is never left half done.
+*/
+static void run_workers(void *segments, size_t segment_size, size_t num_threads, void *(*func)(void *)) {
+  pthread_t threads[num_threads];
+  size_t created = 0;
+
+  for (size_t i = 0; i < num_threads; i++) {
+    void *segment = (char *)segments + i * segment_size;
+    if (memory_thread_create(&threads[created], func, segment) == 0) {
+      created++;
+    } else {
+      func(segment);
+    }
+  }
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+#define REAL double
+#define FN(name) name##_d
+#include "dft_split_impl.h"
+#undef REAL
+#undef FN
+
+#define REAL float
+#define FN(name) name##_f
+#include "dft_split_impl.h"
+#undef REAL
+#undef FN
+
+int amath_dft_split(double *re, double *im, size_t size, size_t n_threads) {
+  PROFILE_BEGIN(scope);
+  int status = split_dft_d(re, im, size, n_threads, 0);
+  PROFILE_CALL(scope, PROFILE_DFT_SPLIT, sizeof(double) * size * 2);
+  return status;
+}
+
+int amath_inverse_dft_split(double *re, double *im, size_t size, size_t n_threads) {
+  PROFILE_BEGIN(scope);
+  int status = split_dft_d(re, im, size, n_threads, 1);
+  PROFILE_CALL(scope, PROFILE_INVERSE_DFT_SPLIT, sizeof(double) * size * 2);
+  return status;
+}
+
+int amath_dft_splitf(float *re, float *im, size_t size, size_t n_threads) {
+  PROFILE_BEGIN(scope);
+  int status = split_dft_f(re, im, size, n_threads, 0);
+  PROFILE_CALL(scope, PROFILE_DFT_SPLITF, sizeof(float) * size * 2);
+  return status;
+}
+
+int amath_inverse_dft_splitf(float *re, float *im, size_t size, size_t n_threads) {
+  PROFILE_BEGIN(scope);
+  int status = split_dft_f(re, im, size, n_threads, 1);
+  PROFILE_CALL(scope, PROFILE_INVERSE_DFT_SPLITF, sizeof(float) * size * 2);
+  return status;
+}
+
+static int interleaved_dftf(float complex *data, size_t size, size_t n_threads, int inverse) {
+  if (data == NULL || size == 0 || n_threads == 0) return -1;
+  PROFILE_BEGIN(scope);
+
+  float *re;
+  if (posix_memalign((void **)&re, 64, sizeof(float) * size * 2) != 0) {
+    return -1;
+  }
+  float *im = re + size;
+
+  for (size_t i = 0; i < size; i++) {
+    re[i] = crealf(data[i]);
+    im[i] = cimagf(data[i]);
+  }
+
+  int status = split_dft_f(re, im, size, n_threads, inverse);
+  if (status == 0) {
+    for (size_t i = 0; i < size; i++) {
+      data[i] = CMPLXF(re[i], im[i]);
+    }
+  }
+
+  free(re);
+  PROFILE_CALL(scope, inverse ? PROFILE_INVERSE_DFTF : PROFILE_DFTF, sizeof(float complex) * size);
+  return status;
+}
+
+int amath_dftf(float complex *data, size_t size, size_t n_threads) {
+  return interleaved_dftf(data, size, n_threads, 0);
+}
+
+int amath_inverse_dftf(float complex *data, size_t size, size_t n_threads) {
+  return interleaved_dftf(data, size, n_threads, 1);
+}
@@ -0,0 +1,193 @@
+/*
+  Split-complex transform engine, included by dft_split.c once per precision.
+  The includer defines REAL (float or double) and FN(name), which appends the
+  precision suffix to every symbol defined here.
+*/
+
+struct FN(split_segment) {
+  REAL *re, *im;
+  REAL *out_re, *out_im;
+  const REAL *tw_re, *tw_im;
+  size_t size, len;
+  size_t index_start, index_end;
+  int inverse;
+};
+
+static REAL *FN(split_twiddles)(size_t size, size_t count) {
+  REAL *twiddles;
+  if (posix_memalign((void **)&twiddles, 64, sizeof(REAL) * count * 2) != 0) {
+    return NULL;
+  }
+  for (size_t k = 0; k < count; k++) {
+    twiddles[k] = (REAL)cos(2 * M_PI * k / size);
+    twiddles[count + k] = (REAL)-sin(2 * M_PI * k / size);
+  }
+  return twiddles;
+}
+
+static void FN(split_bit_reverse)(REAL *re, REAL *im, size_t n) {
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      REAL temp = re[i];
+      re[i] = re[j];
+      re[j] = temp;
+      temp = im[i];
+      im[i] = im[j];
+      im[j] = temp;
+    }
+  }
+}
+
+/*
+  Butterflies of one radix-2 stage of length len over the block starting at start.
+  The twiddle for position k is tw[k * (size / len)].
+*/
+static inline void FN(split_butterflies)(REAL *restrict re, REAL *restrict im, const REAL *restrict tw_re,
+                                         const REAL *restrict tw_im, size_t size, size_t start, size_t len,
+                                         size_t k_start, size_t k_end, int inverse) {
+  size_t half = len >> 1, tw_step = size / len;
+  REAL sign = inverse ? -1 : 1;
+  REAL *restrict er = re + start, *restrict ei = im + start;
+  REAL *restrict or = re + start + half, *restrict oi = im + start + half;
+
+  for (size_t k = k_start; k < k_end; k++) {
+    REAL wr = tw_re[k * tw_step], wi = sign * tw_im[k * tw_step];
+    REAL xr = or[k] * wr - oi[k] * wi;
+    REAL xi = or[k] * wi + oi[k] * wr;
+    or[k] = er[k] - xr;
+    oi[k] = ei[k] - xi;
+    er[k] += xr;
+    ei[k] += xi;
+  }
+}
+
+/* Runs every stage up to len on the contiguous, independent chunk [index_start, index_end). */
+static void *FN(split_fft_chunk)(void *arg) {
+  struct FN(split_segment) *s = (struct FN(split_segment) *)arg;
+  for (size_t len = 2; len <= s->len; len <<= 1) {
+    for (size_t start = s->index_start; start < s->index_end; start += len) {
+      FN(split_butterflies)(s->re, s->im, s->tw_re, s->tw_im, s->size, start, len, 0, len >> 1, s->inverse);
+    }
+  }
+  return NULL;
+}
+
+/* Runs the butterflies [index_start, index_end) of the single stage of length len. */
+static void *FN(split_fft_stage)(void *arg) {
+  struct FN(split_segment) *s = (struct FN(split_segment) *)arg;
+  size_t half = s->len >> 1;
+  size_t b = s->index_start;
+
+  while (b < s->index_end) {
+    size_t block = b / half, k = b % half;
+    size_t k_end = half - k < s->index_end - b ? half : k + (s->index_end - b);
+    FN(split_butterflies)(s->re, s->im, s->tw_re, s->tw_im, s->size, block * s->len, s->len, k, k_end, s->inverse);
+    b += k_end - k;
+  }
+  return NULL;
+}
+
+/*
+  Direct transform of the bins [index_start, index_end), used for sizes that are not
+  a power of two. Sums run over the whole signal, so they are accumulated in double.
+*/
+static void *FN(split_direct)(void *arg) {
+  struct FN(split_segment) *s = (struct FN(split_segment) *)arg;
+  size_t n = s->size;
+  double sign = s->inverse ? -1 : 1;
+
+  for (size_t k = s->index_start; k < s->index_end; k++) {
+    double total_re = 0, total_im = 0;
+    size_t index = 0;
+    for (size_t j = 0; j < n; j++) {
+      double wr = s->tw_re[index], wi = sign * s->tw_im[index];
+      total_re += s->re[j] * wr - s->im[j] * wi;
+      total_im += s->re[j] * wi + s->im[j] * wr;
+      index += k;
+      if (index >= n) index -= n;
+    }
+    s->out_re[k] = (REAL)total_re;
+    s->out_im[k] = (REAL)total_im;
+  }
+  return NULL;
+}
+
+static void FN(split_fill)(struct FN(split_segment) *segments, size_t num_threads, size_t units, size_t granularity,
+                           const struct FN(split_segment) *base) {
+  size_t groups = units / granularity;
+  size_t step = groups / num_threads, remaining = groups % num_threads, position = 0;
+  for (size_t i = 0; i < num_threads; i++) {
+    segments[i] = *base;
+    segments[i].index_start = position;
+    position += (step + (i < remaining ? 1 : 0)) * granularity;
+    segments[i].index_end = position;
+  }
+}
+
+static int FN(split_dft)(REAL *re, REAL *im, size_t size, size_t n_threads, int inverse) {
+  if (re == NULL || im == NULL || size == 0 || n_threads == 0) return -1;
+
+  int pow2 = fft_is_pow2(size);
+  REAL *twiddles = FN(split_twiddles)(size, pow2 ? (size / 2 > 0 ? size / 2 : 1) : size);
+  if (twiddles == NULL) return -1;
+
+  REAL *out = NULL;
+  if (!pow2 && posix_memalign((void **)&out, 64, sizeof(REAL) * size * 2) != 0) {
+    free(twiddles);
+    return -1;
+  }
+
+  size_t max_threads = pow2 ? (size / 2 > 0 ? size / 2 : 1) : size;
+  size_t num_threads = n_threads <= max_threads ? n_threads : max_threads;
+  struct FN(split_segment) *segments;
+  if (posix_memalign((void **)&segments, 64, sizeof(struct FN(split_segment)) * num_threads) != 0) {
+    free(out);
+    free(twiddles);
+    return -1;
+  }
+
+  struct FN(split_segment) base = {
+    .re = re, .im = im,
+    .out_re = out, .out_im = out != NULL ? out + size : NULL,
+    .tw_re = twiddles, .tw_im = twiddles + (pow2 ? (size / 2 > 0 ? size / 2 : 1) : size),
+    .size = size, .len = size, .inverse = inverse
+  };
+  if (!pow2) {
+    FN(split_fill)(segments, num_threads, size, 1, &base);
+    run_workers(segments, sizeof(struct FN(split_segment)), num_threads, FN(split_direct));
+    memcpy(re, out, sizeof(REAL) * size);
+    memcpy(im, out + size, sizeof(REAL) * size);
+  } else if (size > 1) {
+    FN(split_bit_reverse)(re, im, size);
+
+    /* Early stages work on independent chunks, one per thread. */
+    size_t chunks = 1;
+    while (chunks * 2 <= num_threads) chunks *= 2;
+    base.len = size / chunks;
+    FN(split_fill)(segments, chunks, size, base.len, &base);
+    run_workers(segments, sizeof(struct FN(split_segment)), chunks, FN(split_fft_chunk));
+
+    /* The remaining log2(chunks) stages split their butterflies across threads. */
+    for (size_t len = base.len * 2; len <= size; len <<= 1) {
+      base.len = len;
+      FN(split_fill)(segments, num_threads, size / 2, 1, &base);
+      run_workers(segments, sizeof(struct FN(split_segment)), num_threads, FN(split_fft_stage));
+    }
+  }
+
+  if (inverse) {
+    REAL scale = (REAL)(1.0 / size);
+    for (size_t i = 0; i < size; i++) {
+      re[i] *= scale;
+      im[i] *= scale;
+    }
+  }
+
+  free(segments);
+  free(out);
+  free(twiddles);
+  return 0;
+}
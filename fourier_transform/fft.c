@@ -0,0 +1,97 @@
+#include "fft.h"
+#include <math.h>
+#include <stdlib.h>
+
+int fft_is_pow2(size_t n) {
+  return n != 0 && (n & (n - 1)) == 0;
+}
+
+size_t fft_next_pow2(size_t n) {
+  size_t p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+double complex *fft_twiddles(size_t n) {
+  size_t half = n / 2 > 0 ? n / 2 : 1;
+  double complex *twiddles;
+  if (posix_memalign((void **)&twiddles, 64, sizeof(double complex) * half) != 0) {
+    return NULL;
+  }
+  for (size_t k = 0; k < half; k++) {
+    twiddles[k] = cexp(-I * 2 * M_PI * k / n);
+  }
+  return twiddles;
+}
+
+static void bit_reverse(double complex *data, size_t n) {
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      double complex temp = data[i];
+      data[i] = data[j];
+      data[j] = temp;
+    }
+  }
+}
+
+void fft_radix2(double complex *data, size_t n, const double complex *twiddles, int inverse) {
+  if (n < 2) return;
+  bit_reverse(data, n);
+
+  for (size_t len = 2; len <= n; len <<= 1) {
+    size_t half = len >> 1;
+    size_t tw_step = n / len;
+    for (size_t start = 0; start < n; start += len) {
+      for (size_t k = 0; k < half; k++) {
+        double wr = creal(twiddles[k * tw_step]);
+        double wi = inverse ? -cimag(twiddles[k * tw_step]) : cimag(twiddles[k * tw_step]);
+        double complex even = data[start + k];
+        double complex x = data[start + k + half];
+        double complex odd = CMPLX(creal(x) * wr - cimag(x) * wi, creal(x) * wi + cimag(x) * wr);
+        data[start + k] = even + odd;
+        data[start + k + half] = even - odd;
+      }
+    }
+  }
+}
+
+double complex *fft_any_twiddles(size_t size) {
+  if (fft_is_pow2(size)) return fft_twiddles(size);
+
+  double complex *twiddles;
+  if (posix_memalign((void **)&twiddles, 64, sizeof(double complex) * size) != 0) {
+    return NULL;
+  }
+  for (size_t k = 0; k < size; k++) {
+    twiddles[k] = cexp(-I * 2 * M_PI * k / size);
+  }
+  return twiddles;
+}
+
+void fft_transform(double complex *data, size_t size, const double complex *twiddles,
+                   double complex *scratch, int inverse) {
+  if (fft_is_pow2(size)) {
+    fft_radix2(data, size, twiddles, inverse);
+    return;
+  }
+
+  for (size_t k = 0; k < size; k++) {
+    double total_re = 0, total_im = 0;
+    size_t index = 0;
+    for (size_t j = 0; j < size; j++) {
+      double wr = creal(twiddles[index]);
+      double wi = inverse ? -cimag(twiddles[index]) : cimag(twiddles[index]);
+      total_re += creal(data[j]) * wr - cimag(data[j]) * wi;
+      total_im += creal(data[j]) * wi + cimag(data[j]) * wr;
+      index += k;
+      if (index >= size) index -= size;
+    }
+    scratch[k] = CMPLX(total_re, total_im);
+  }
+  for (size_t k = 0; k < size; k++) {
+    data[k] = scratch[k];
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef __AMATH_FFT
+#define __AMATH_FFT
+
+#include <complex.h>
+#include <stddef.h>
+
+/*
+  Internal radix-2 Fast Fourier Transform shared by the modules that need
+  O(n log n) transforms. These symbols are not part of the public API.
+*/
+
+#define AMATH_INTERNAL __attribute__((visibility("hidden")))
+
+/*
+  Returns 1 if n is a power of two, 0 otherwise.
+*/
+AMATH_INTERNAL int fft_is_pow2(size_t n);
+
+/*
+  Returns the smallest power of two greater than or equal to n.
+*/
+AMATH_INTERNAL size_t fft_next_pow2(size_t n);
+
+/*
+  Returns a new table with the n / 2 forward twiddle factors exp(-2*pi*i*k/n)
+  for a transform of size n, or NULL on error. Free it after usage.
+*/
+AMATH_INTERNAL double complex *fft_twiddles(size_t n);
+
+/*
+  In-place, unnormalised radix-2 FFT of the n (power of two) elements of data,
+  using the table returned by fft_twiddles(n). Use inverse = 1 for the
+  backward transform; the caller is responsible for the 1 / n scaling.
+*/
+AMATH_INTERNAL void fft_radix2(double complex *data, size_t n, const double complex *twiddles, int inverse);
+
+/*
+  Returns a new twiddle table for a transform of any size: the fft_twiddles table
+  when size is a power of two, otherwise all size factors exp(-2*pi*i*k/size).
+  Returns NULL on error. Free it after usage.
+*/
+AMATH_INTERNAL double complex *fft_any_twiddles(size_t size);
+
+/*
+  In-place, unnormalised transform of the size elements of data using the table
+  returned by fft_any_twiddles(size). Power of two sizes use the radix-2 FFT, other
+  sizes a direct transform that needs a scratch buffer of size elements.
+*/
+AMATH_INTERNAL void fft_transform(double complex *data, size_t size, const double complex *twiddles,
+                                  double complex *scratch, int inverse);
+
+#endif  // __AMATH_FFT
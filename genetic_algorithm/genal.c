@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include "../amath.h"
 
 #define RANDOM_NUMBER_FUNC(min, max) ( min + ( rand() / (float)RAND_MAX ) * (max - min) )
@@ -13,13 +14,29 @@ static void destroy_individual_array(Individual **individuals, unsigned int n_in
   free(individuals);
 }
 
-static int compare_individuals(const void* a, const void* b) {
-    const Individual *arg1 = *(const Individual **)a;
-    const Individual *arg2 = *(const Individual **)b;
+/*
+  Sorts the individuals by descending fitness: argsorting the negated fitness keeps
+  individuals with a NAN fitness at the end, among the ones to be replaced.
+*/
+static int sort_individuals(Individual **individual_array, unsigned int array_size) {
+  double *keys = malloc(sizeof(double) * array_size);
+  size_t *order = malloc(sizeof(size_t) * array_size);
+  Individual **sorted = malloc(sizeof(Individual*) * array_size);
+  int status = -1;
 
-    if (arg1->fitness > arg2->fitness) return -1;
-    if (arg1->fitness < arg2->fitness) return 1;
-    return 0;
+  if (keys != NULL && order != NULL && sorted != NULL) {
+    for (unsigned int i = 0; i < array_size; i++) keys[i] = -individual_array[i]->fitness;
+    status = amath_argsort(keys, array_size, order, 1);
+  }
+  if (status == 0) {
+    for (unsigned int i = 0; i < array_size; i++) sorted[i] = individual_array[order[i]];
+    memcpy(individual_array, sorted, sizeof(Individual*) * array_size);
+  }
+
+  free(keys);
+  free(order);
+  free(sorted);
+  return status;
 }
 
 static void reproduction(Individual *ind1, Individual *ind2, Individual *result, unsigned int n_weights) {
@@ -95,7 +112,7 @@ int amath_reproduce(Individuals *individuals) {
   Individual **individual_array = individuals->individual_array;
   unsigned int array_size = individuals->n_individuals;
   unsigned int individuals_to_reproduce = floor(array_size * individuals->reproduction_rate);
-  qsort(individual_array, array_size, sizeof(Individual*), compare_individuals);
+  if (sort_individuals(individual_array, array_size) != 0) return -1;
   for (int i = 0; i < individuals_to_reproduce; i ++) {
     reproduction(individual_array[i*2], individual_array[(i*2)+1], individual_array[array_size-1-i], individuals->number_weights);
   }
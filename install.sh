@@ -24,6 +24,9 @@ rm -r lib$lib_name.so
 sudo cp $lib_name.h /usr/include
 check_error "Error copying header file to /usr/include."
 
+sudo cp ${lib_name}_inline.h /usr/include
+check_error "Error copying inline header file to /usr/include."
+
 sudo cp $lib_name /usr/local/bin
 check_error "Error copying executable to /usr/local/bin."
 
@@ -0,0 +1,306 @@
+#include "../amath.h"
+#include "../memory/memory.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+  Jobs are run by a fixed set of worker threads, started by the first submission,
+  which take them from a FIFO queue. A job chained to another one waits in the list
+  of followers of its predecessor and is queued when the predecessor is done.
+  Every job is referenced by its handle and by the pool until it leaves the queue
+  or the followers list, and is freed when both are gone.
+
+  The library functions run by a job still spawn their own threads for the call.
+  Their number is capped to the job's share of the workers (one per CPU), so jobs
+  running side by side don't oversubscribe the machine.
+*/
+#define MAX_JOB_WORKERS 64
+
+struct job_args {
+  void *data;
+  size_t size, n_threads;
+  double lambda;
+};
+
+struct Job {
+  jobfunc *func;
+  void *arg, *previous, *result;
+  JobStatus status;
+  unsigned int references;
+  struct Job *next, *followers, *next_follower;
+  struct job_args args;
+};
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t queued, ended;
+  pthread_once_t ended_once;
+  Job *head, *tail;
+  size_t n_workers, n_running;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_ONCE_INIT};
+
+/* Timed waits use the monotonic clock, so they are not affected by clock changes. */
+static void init_ended(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_destroy(&pool.ended);
+  pthread_cond_init(&pool.ended, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+static int is_pending(const Job *job) {
+  return job->status == AMATH_JOB_QUEUED || job->status == AMATH_JOB_RUNNING;
+}
+
+/* The functions below are called with the pool lock held. */
+
+static void release(Job *job) {
+  if (--job->references == 0) free(job);
+}
+
+static void enqueue(Job *job) {
+  job->next = NULL;
+  if (pool.tail != NULL) {
+    pool.tail->next = job;
+  } else {
+    pool.head = job;
+  }
+  pool.tail = job;
+  pthread_cond_signal(&pool.queued);
+}
+
+static void cancel_followers(Job *job) {
+  for (Job *follower = job->followers; follower != NULL; follower = follower->next_follower) {
+    if (follower->status == AMATH_JOB_QUEUED) {
+      follower->status = AMATH_JOB_CANCELLED;
+      cancel_followers(follower);
+    }
+  }
+}
+
+/* Hands the followers of a job that ended to the queue, or cancels them, and drops the pool reference. */
+static void settle(Job *job) {
+  Job *follower = job->followers;
+  job->followers = NULL;
+  while (follower != NULL) {
+    Job *next = follower->next_follower;
+    if (job->status == AMATH_JOB_DONE && follower->status == AMATH_JOB_QUEUED) {
+      follower->previous = job->result;
+      enqueue(follower);
+    } else {
+      if (follower->status == AMATH_JOB_QUEUED) follower->status = AMATH_JOB_CANCELLED;
+      settle(follower);
+    }
+    follower = next;
+  }
+  pthread_cond_broadcast(&pool.ended);
+  release(job);
+}
+
+static void *job_worker(void *arg) {
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.head == NULL) pthread_cond_wait(&pool.queued, &pool.lock);
+    Job *job = pool.head;
+    pool.head = job->next;
+    if (pool.head == NULL) pool.tail = NULL;
+
+    if (job->status == AMATH_JOB_QUEUED) {
+      job->status = AMATH_JOB_RUNNING;
+      pool.n_running++;
+      size_t share = pool.n_workers / pool.n_running;
+      if (share == 0) share = 1;
+      if (job->arg == &job->args && job->args.n_threads > share) job->args.n_threads = share;
+
+      pthread_mutex_unlock(&pool.lock);
+      void *result = job->func(job->arg, job->previous);
+      pthread_mutex_lock(&pool.lock);
+      pool.n_running--;
+      job->result = result;
+      job->status = result != NULL ? AMATH_JOB_DONE : AMATH_JOB_FAILED;
+    }
+    settle(job);
+  }
+  return NULL;
+}
+
+static int start_workers(void) {
+  if (pool.n_workers > 0) return 0;
+  pthread_once(&pool.ended_once, init_ended);
+
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t n_workers = n_cpus < 1 ? 1 : n_cpus > MAX_JOB_WORKERS ? MAX_JOB_WORKERS : (size_t)n_cpus;
+  for (; pool.n_workers < n_workers; pool.n_workers++) {
+    pthread_t thread;
+    if (memory_thread_create(&thread, job_worker, NULL) != 0) break;
+    pthread_detach(thread);
+  }
+  return pool.n_workers > 0 ? 0 : -1;
+}
+
+static Job *create_job(jobfunc func, void *arg) {
+  Job *job = malloc(sizeof(Job));
+  if (job == NULL) return NULL;
+  *job = (Job){.func = func, .arg = arg, .status = AMATH_JOB_QUEUED, .references = 2};
+  return job;
+}
+
+/* Queues a new job, starting the workers if needed. Frees it and returns NULL on error. */
+static Job *submit_job(Job *job) {
+  pthread_mutex_lock(&pool.lock);
+  if (start_workers() != 0) {
+    pthread_mutex_unlock(&pool.lock);
+    free(job);
+    return NULL;
+  }
+  enqueue(job);
+  pthread_mutex_unlock(&pool.lock);
+  return job;
+}
+
+Job *amath_submit(jobfunc func, void *arg) {
+  if (func == NULL) return NULL;
+  Job *job = create_job(func, arg);
+  return job != NULL ? submit_job(job) : NULL;
+}
+
+Job *amath_job_then(Job *job, jobfunc func, void *arg) {
+  if (job == NULL || func == NULL) return NULL;
+  Job *follower = create_job(func, arg);
+  if (follower == NULL) return NULL;
+
+  pthread_mutex_lock(&pool.lock);
+  if (start_workers() != 0) {
+    pthread_mutex_unlock(&pool.lock);
+    free(follower);
+    return NULL;
+  }
+  if (is_pending(job)) {
+    follower->next_follower = job->followers;
+    job->followers = follower;
+  } else if (job->status == AMATH_JOB_DONE) {
+    follower->previous = job->result;
+    enqueue(follower);
+  } else {
+    follower->status = AMATH_JOB_CANCELLED;
+    follower->references--;
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return follower;
+}
+
+static void *run_dft(void *arg, void *previous) {
+  struct job_args *args = (struct job_args *)arg;
+  return amath_dft(args->data, args->size, args->n_threads) == 0 ? args->data : NULL;
+}
+
+static void *run_inverse_dft(void *arg, void *previous) {
+  struct job_args *args = (struct job_args *)arg;
+  return amath_inverse_dft(args->data, args->size, args->n_threads) == 0 ? args->data : NULL;
+}
+
+static void *run_ndist(void *arg, void *previous) {
+  struct job_args *args = (struct job_args *)arg;
+  return amath_ndist(args->data, args->size, args->n_threads);
+}
+
+static void *run_pdist(void *arg, void *previous) {
+  struct job_args *args = (struct job_args *)arg;
+  return amath_pdist(args->data, args->lambda, args->size, args->n_threads);
+}
+
+/* Queues a library function whose arguments are kept in the job itself. */
+static Job *submit_args(jobfunc func, struct job_args args) {
+  if (args.data == NULL || args.size == 0 || args.n_threads == 0) return NULL;
+  Job *job = create_job(func, NULL);
+  if (job == NULL) return NULL;
+  job->args = args;
+  job->arg = &job->args;
+  return submit_job(job);
+}
+
+Job *amath_submit_dft(double complex *data, size_t size, size_t n_threads) {
+  return submit_args(run_dft, (struct job_args){.data = data, .size = size, .n_threads = n_threads});
+}
+
+Job *amath_submit_inverse_dft(double complex *data, size_t size, size_t n_threads) {
+  return submit_args(run_inverse_dft, (struct job_args){.data = data, .size = size, .n_threads = n_threads});
+}
+
+Job *amath_submit_ndist(double *data, size_t n_elements, size_t n_threads) {
+  return submit_args(run_ndist, (struct job_args){.data = data, .size = n_elements, .n_threads = n_threads});
+}
+
+Job *amath_submit_pdist(int *data, double lambda, size_t n_elements, size_t n_threads) {
+  return submit_args(run_pdist, (struct job_args){
+    .data = data, .size = n_elements, .n_threads = n_threads, .lambda = lambda
+  });
+}
+
+JobStatus amath_job_poll(Job *job) {
+  if (job == NULL) return AMATH_JOB_FAILED;
+  pthread_mutex_lock(&pool.lock);
+  JobStatus status = job->status;
+  pthread_mutex_unlock(&pool.lock);
+  return status;
+}
+
+JobStatus amath_job_wait(Job *job, long timeout_ms) {
+  if (job == NULL) return AMATH_JOB_FAILED;
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  if (timeout_ms >= 0) {
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+  }
+
+  pthread_mutex_lock(&pool.lock);
+  while (is_pending(job)) {
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&pool.ended, &pool.lock);
+    } else if (pthread_cond_timedwait(&pool.ended, &pool.lock, &deadline) == ETIMEDOUT) {
+      break;
+    }
+  }
+  JobStatus status = job->status;
+  pthread_mutex_unlock(&pool.lock);
+  return status;
+}
+
+int amath_job_cancel(Job *job) {
+  if (job == NULL) return -1;
+  pthread_mutex_lock(&pool.lock);
+  int status = -1;
+  if (job->status == AMATH_JOB_QUEUED) {
+    job->status = AMATH_JOB_CANCELLED;
+    cancel_followers(job);
+    pthread_cond_broadcast(&pool.ended);
+    status = 0;
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return status;
+}
+
+void *amath_job_result(Job *job) {
+  if (job == NULL) return NULL;
+  pthread_mutex_lock(&pool.lock);
+  void *result = job->status == AMATH_JOB_DONE ? job->result : NULL;
+  pthread_mutex_unlock(&pool.lock);
+  return result;
+}
+
+void amath_destroy_job(Job *job) {
+  if (job == NULL) return;
+  pthread_mutex_lock(&pool.lock);
+  release(job);
+  pthread_mutex_unlock(&pool.lock);
+}
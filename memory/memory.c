@@ -0,0 +1,89 @@
+#define _GNU_SOURCE
+#include "../amath.h"
+#include "memory.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Buffers smaller than this are never worth a system call. */
+#define PLACEMENT_MIN ((size_t)1 << 20)
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define ALLOC_POLICY_MASK (AMATH_ALLOC_FIRST_TOUCH | AMATH_ALLOC_HUGE_PAGES | AMATH_PIN_THREADS)
+
+static atomic_uint alloc_policy;
+
+/*
+  CPUs the process was allowed to run on when the first thread was pinned. Threads
+  take them in turn from a process-wide cursor, so concurrent calls spread out.
+*/
+static pthread_once_t cpus_once = PTHREAD_ONCE_INIT;
+static int cpus[CPU_SETSIZE];
+static size_t n_cpus;
+static atomic_size_t next_cpu;
+
+static void find_cpus(void) {
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) return;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) cpus[n_cpus++] = cpu;
+  }
+}
+
+int amath_set_alloc_policy(unsigned int policy) {
+  if ((policy & ~ALLOC_POLICY_MASK) != 0) return -1;
+#ifndef MADV_HUGEPAGE
+  if (policy & AMATH_ALLOC_HUGE_PAGES) return -1;
+#endif
+  atomic_store(&alloc_policy, policy);
+  return 0;
+}
+
+unsigned int amath_get_alloc_policy(void) {
+  return atomic_load(&alloc_policy);
+}
+
+void *memory_alloc(size_t bytes) {
+  unsigned int policy = atomic_load_explicit(&alloc_policy, memory_order_relaxed);
+  int placed = bytes >= PLACEMENT_MIN && (policy & (AMATH_ALLOC_FIRST_TOUCH | AMATH_ALLOC_HUGE_PAGES));
+  size_t page = placed ? (size_t)sysconf(_SC_PAGESIZE) : 64;
+  size_t alignment = placed && (policy & AMATH_ALLOC_HUGE_PAGES) ? HUGE_PAGE_SIZE : page;
+
+  void *buffer;
+  if (posix_memalign(&buffer, alignment, bytes) != 0) return NULL;
+  if (!placed) return buffer;
+
+  /*
+    The allocator may hand back pages another thread already touched. Dropping
+    them leaves the range unbacked (reading as zeros) until a worker writes it.
+  */
+  size_t length = bytes - bytes % page;
+  if (policy & AMATH_ALLOC_FIRST_TOUCH) madvise(buffer, length, MADV_DONTNEED);
+#ifdef MADV_HUGEPAGE
+  if (policy & AMATH_ALLOC_HUGE_PAGES) madvise(buffer, length, MADV_HUGEPAGE);
+#endif
+  return buffer;
+}
+
+int memory_thread_create(pthread_t *thread, void *(*routine)(void *), void *arg) {
+  if (!(atomic_load_explicit(&alloc_policy, memory_order_relaxed) & AMATH_PIN_THREADS)) {
+    return pthread_create(thread, NULL, routine, arg);
+  }
+
+  pthread_once(&cpus_once, find_cpus);
+  pthread_attr_t attr;
+  if (n_cpus == 0 || pthread_attr_init(&attr) != 0) return pthread_create(thread, NULL, routine, arg);
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[atomic_fetch_add_explicit(&next_cpu, 1, memory_order_relaxed) % n_cpus], &set);
+  int status = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+  if (status == 0) status = pthread_create(thread, &attr, routine, arg);
+  pthread_attr_destroy(&attr);
+
+  /* A thread that can't be pinned still runs, unpinned. */
+  if (status != 0) status = pthread_create(thread, NULL, routine, arg);
+  return status;
+}
@@ -0,0 +1,31 @@
+#ifndef __AMATH_MEMORY
+#define __AMATH_MEMORY
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+  Internal buffer and thread placement helpers, following the policy set with
+  amath_set_alloc_policy. These symbols are not part of the public API.
+*/
+
+#define MEMORY_INTERNAL __attribute__((visibility("hidden")))
+
+/*
+  Allocates bytes for a buffer that worker threads fill segment by segment. The
+  buffer is 64 byte aligned and can be released with free(). Under
+  AMATH_ALLOC_FIRST_TOUCH the pages of a large buffer are left untouched, so each
+  one is placed on the node of the worker that writes it first, and under
+  AMATH_ALLOC_HUGE_PAGES a large buffer is backed by transparent huge pages.
+  Returns NULL on error.
+*/
+MEMORY_INTERNAL void *memory_alloc(size_t bytes);
+
+/*
+  pthread_create for a worker thread. Under AMATH_PIN_THREADS the thread is pinned
+  to the next allowed CPU in turn, or left unpinned if that fails.
+  Returns 0 if successfull, an error number if not.
+*/
+MEMORY_INTERNAL int memory_thread_create(pthread_t *thread, void *(*routine)(void *), void *arg);
+
+#endif  // __AMATH_MEMORY
@@ -0,0 +1,248 @@
+#include "../amath.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef AMATH_PROFILE
+
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Maximum number of trace events kept per run. Later events are dropped and counted. */
+#define TRACE_CAPACITY 65536
+
+static const char *FUNCTION_NAMES[PROFILE_COUNT] = {
+  "amath_dft",
+  "amath_inverse_dft",
+  "amath_dft_many",
+  "amath_inverse_dft_many",
+  "amath_dft_split",
+  "amath_inverse_dft_split",
+  "amath_dft_splitf",
+  "amath_inverse_dft_splitf",
+  "amath_dftf",
+  "amath_inverse_dftf",
+  "amath_dftnd",
+  "amath_convolve",
+  "amath_xcorr",
+  "amath_ndist",
+  "amath_pdist",
+  "amath_histogram",
+  "amath_kde",
+  "amath_sort",
+  "amath_argsort"
+};
+
+static const char *PHASE_NAMES[] = {"alloc", "spawn"};
+
+struct profile_counters {
+  _Atomic unsigned long long calls, bytes, wall_ns, cpu_ns, alloc_ns, spawn_ns;
+  _Atomic unsigned long long chunks, chunk_ns, chunk_max_ns;
+};
+
+/* ready holds the run the event was recorded in, stored once the other fields are written. */
+struct trace_event {
+  const char *name, *category;
+  long tid;
+  unsigned long long start, duration;
+  _Atomic unsigned long long ready;
+};
+
+static struct profile_counters counters[PROFILE_COUNT];
+static atomic_int profiling, tracing;
+
+static struct trace_event events[TRACE_CAPACITY];
+static _Atomic size_t n_events;
+static _Atomic unsigned long long dropped_events, trace_origin, trace_run;
+
+static unsigned long long clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long thread_id(void) {
+  static _Thread_local long tid;
+  if (tid == 0) tid = syscall(SYS_gettid);
+  return tid;
+}
+
+static void trace(const char *name, const char *category, unsigned long long start, unsigned long long end) {
+  if (!atomic_load_explicit(&tracing, memory_order_relaxed)) return;
+  unsigned long long run = atomic_load(&trace_run);
+  size_t index = atomic_fetch_add(&n_events, 1);
+  if (index >= TRACE_CAPACITY) {
+    atomic_fetch_add(&dropped_events, 1);
+    return;
+  }
+  struct trace_event *e = &events[index];
+  e->name = name;
+  e->category = category;
+  e->tid = thread_id();
+  e->start = start;
+  e->duration = end - start;
+  atomic_store_explicit(&e->ready, run, memory_order_release);
+}
+
+unsigned long long profile_now(void) {
+  if (!atomic_load_explicit(&profiling, memory_order_relaxed) &&
+      !atomic_load_explicit(&tracing, memory_order_relaxed)) {
+    return 0;
+  }
+  return clock_ns(CLOCK_MONOTONIC);
+}
+
+struct profile_scope profile_begin(void) {
+  struct profile_scope scope = {profile_now(), 0};
+  if (scope.wall != 0) scope.cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+  return scope;
+}
+
+void profile_call(const struct profile_scope *scope, enum profile_id id, unsigned long long bytes) {
+  if (scope->wall == 0) return;
+  unsigned long long end = clock_ns(CLOCK_MONOTONIC);
+
+  if (atomic_load_explicit(&profiling, memory_order_relaxed)) {
+    struct profile_counters *c = &counters[id];
+    atomic_fetch_add(&c->calls, 1);
+    atomic_fetch_add(&c->bytes, bytes);
+    atomic_fetch_add(&c->wall_ns, end - scope->wall);
+    atomic_fetch_add(&c->cpu_ns, clock_ns(CLOCK_PROCESS_CPUTIME_ID) - scope->cpu);
+  }
+  trace(FUNCTION_NAMES[id], "call", scope->wall, end);
+}
+
+void profile_phase(enum profile_id id, enum profile_phase phase, unsigned long long start) {
+  if (start == 0) return;
+  unsigned long long end = clock_ns(CLOCK_MONOTONIC);
+
+  if (atomic_load_explicit(&profiling, memory_order_relaxed)) {
+    if (phase == PROFILE_PHASE_ALLOC) {
+      atomic_fetch_add(&counters[id].alloc_ns, end - start);
+    } else {
+      atomic_fetch_add(&counters[id].spawn_ns, end - start);
+    }
+  }
+  trace(PHASE_NAMES[phase], FUNCTION_NAMES[id], start, end);
+}
+
+void profile_chunk(enum profile_id id, unsigned long long start) {
+  if (start == 0) return;
+  unsigned long long end = clock_ns(CLOCK_MONOTONIC);
+  unsigned long long elapsed = end - start;
+
+  if (atomic_load_explicit(&profiling, memory_order_relaxed)) {
+    struct profile_counters *c = &counters[id];
+    atomic_fetch_add(&c->chunks, 1);
+    atomic_fetch_add(&c->chunk_ns, elapsed);
+    unsigned long long max = atomic_load(&c->chunk_max_ns);
+    while (elapsed > max && !atomic_compare_exchange_weak(&c->chunk_max_ns, &max, elapsed));
+  }
+  trace("chunk", FUNCTION_NAMES[id], start, end);
+}
+
+int amath_profile_enable(unsigned int enabled) {
+  atomic_store(&profiling, enabled ? 1 : 0);
+  return 0;
+}
+
+int amath_trace_enable(unsigned int enabled) {
+  if (enabled) {
+    atomic_fetch_add(&trace_run, 1);
+    atomic_store(&n_events, 0);
+    atomic_store(&dropped_events, 0);
+    atomic_store(&trace_origin, clock_ns(CLOCK_MONOTONIC));
+  }
+  atomic_store(&tracing, enabled ? 1 : 0);
+  return 0;
+}
+
+size_t amath_stats_snapshot(ProfileStats *stats, size_t max_stats) {
+  if (stats == NULL) return 0;
+  size_t count = 0;
+  for (size_t i = 0; i < PROFILE_COUNT && count < max_stats; i++) {
+    struct profile_counters *c = &counters[i];
+    if (atomic_load(&c->calls) == 0) continue;
+    stats[count++] = (ProfileStats){
+      .function = FUNCTION_NAMES[i],
+      .calls = atomic_load(&c->calls),
+      .bytes = atomic_load(&c->bytes),
+      .wall_ns = atomic_load(&c->wall_ns),
+      .cpu_ns = atomic_load(&c->cpu_ns),
+      .alloc_ns = atomic_load(&c->alloc_ns),
+      .spawn_ns = atomic_load(&c->spawn_ns),
+      .chunks = atomic_load(&c->chunks),
+      .chunk_ns = atomic_load(&c->chunk_ns),
+      .chunk_max_ns = atomic_load(&c->chunk_max_ns)
+    };
+  }
+  return count;
+}
+
+void amath_stats_reset(void) {
+  for (size_t i = 0; i < PROFILE_COUNT; i++) {
+    struct profile_counters *c = &counters[i];
+    atomic_store(&c->calls, 0);
+    atomic_store(&c->bytes, 0);
+    atomic_store(&c->wall_ns, 0);
+    atomic_store(&c->cpu_ns, 0);
+    atomic_store(&c->alloc_ns, 0);
+    atomic_store(&c->spawn_ns, 0);
+    atomic_store(&c->chunks, 0);
+    atomic_store(&c->chunk_ns, 0);
+    atomic_store(&c->chunk_max_ns, 0);
+  }
+}
+
+int amath_trace_dump(const char *path) {
+  if (path == NULL) return -1;
+  FILE *file = fopen(path, "w");
+  if (file == NULL) return -1;
+
+  size_t count = atomic_load(&n_events);
+  if (count > TRACE_CAPACITY) count = TRACE_CAPACITY;
+  unsigned long long origin = atomic_load(&trace_origin);
+  unsigned long long run = atomic_load(&trace_run);
+  long pid = (long)getpid();
+
+  /* Events still being written by a running call are left out. */
+  fprintf(file, "{\"traceEvents\":[");
+  int first = 1;
+  for (size_t i = 0; i < count; i++) {
+    struct trace_event *e = &events[i];
+    if (atomic_load_explicit(&e->ready, memory_order_acquire) != run) continue;
+    double ts = e->start >= origin ? (e->start - origin) / 1000.0 : 0.0;
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld}",
+            first ? "" : ",", e->name, e->category, ts, e->duration / 1000.0, pid, e->tid);
+    first = 0;
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%llu}}\n",
+          atomic_load(&dropped_events));
+
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+#else
+
+int amath_profile_enable(unsigned int enabled) {
+  return -1;
+}
+
+int amath_trace_enable(unsigned int enabled) {
+  return -1;
+}
+
+size_t amath_stats_snapshot(ProfileStats *stats, size_t max_stats) {
+  return 0;
+}
+
+void amath_stats_reset(void) {
+}
+
+int amath_trace_dump(const char *path) {
+  return -1;
+}
+
+#endif  // AMATH_PROFILE
@@ -0,0 +1,66 @@
+#ifndef __AMATH_PROFILE
+#define __AMATH_PROFILE
+
+/*
+  Internal instrumentation hooks. With AMATH_PROFILE undefined every macro below
+  expands to nothing, so instrumented code pays no cost at all. With it defined,
+  the hooks only record while profiling or tracing is enabled at runtime.
+*/
+
+enum profile_id {
+  PROFILE_DFT,
+  PROFILE_INVERSE_DFT,
+  PROFILE_DFT_MANY,
+  PROFILE_INVERSE_DFT_MANY,
+  PROFILE_DFT_SPLIT,
+  PROFILE_INVERSE_DFT_SPLIT,
+  PROFILE_DFT_SPLITF,
+  PROFILE_INVERSE_DFT_SPLITF,
+  PROFILE_DFTF,
+  PROFILE_INVERSE_DFTF,
+  PROFILE_DFTND,
+  PROFILE_CONVOLVE,
+  PROFILE_XCORR,
+  PROFILE_NDIST,
+  PROFILE_PDIST,
+  PROFILE_HISTOGRAM,
+  PROFILE_KDE,
+  PROFILE_SORT,
+  PROFILE_ARGSORT,
+  PROFILE_COUNT
+};
+
+enum profile_phase {
+  PROFILE_PHASE_ALLOC,
+  PROFILE_PHASE_SPAWN
+};
+
+#ifdef AMATH_PROFILE
+
+struct profile_scope {
+  unsigned long long wall, cpu;
+};
+
+__attribute__((visibility("hidden"))) unsigned long long profile_now(void);
+__attribute__((visibility("hidden"))) struct profile_scope profile_begin(void);
+__attribute__((visibility("hidden"))) void profile_call(const struct profile_scope *scope, enum profile_id id, unsigned long long bytes);
+__attribute__((visibility("hidden"))) void profile_phase(enum profile_id id, enum profile_phase phase, unsigned long long start);
+__attribute__((visibility("hidden"))) void profile_chunk(enum profile_id id, unsigned long long start);
+
+#define PROFILE_BEGIN(scope) struct profile_scope scope = profile_begin()
+#define PROFILE_CALL(scope, id, bytes) profile_call(&(scope), (id), (bytes))
+#define PROFILE_MARK(mark) unsigned long long mark = profile_now()
+#define PROFILE_PHASE(id, phase, mark) profile_phase((id), (phase), (mark))
+#define PROFILE_CHUNK(id, mark) profile_chunk((id), (mark))
+
+#else
+
+#define PROFILE_BEGIN(scope)
+#define PROFILE_CALL(scope, id, bytes) ((void)0)
+#define PROFILE_MARK(mark)
+#define PROFILE_PHASE(id, phase, mark) ((void)0)
+#define PROFILE_CHUNK(id, mark) ((void)0)
+
+#endif  // AMATH_PROFILE
+
+#endif  // __AMATH_PROFILE
@@ -0,0 +1,383 @@
+#include "../amath.h"
+#include "../memory/memory.h"
+#include "../profiling/profile.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Least significant digit radix sort on the IEEE-754 bit pattern of the values,
+  mapped to unsigned keys that compare like the doubles: negative values have all
+  their bits flipped, positive values only the sign bit. Every pass moves the keys
+  by one RADIX_BITS digit, and passes where all keys share the digit are skipped.
+  With several threads, each sorts a contiguous run and the runs are merged
+  pairwise, every round split evenly across the threads by merge path.
+*/
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES ((64 + RADIX_BITS - 1) / RADIX_BITS)
+#define SIGN_BIT 0x8000000000000000ULL
+/*
+  Below SMALL_SORT_MAX keys the radix counters cost more than the sort itself, so
+  runs of INSERTION_SORT_MAX keys are insertion sorted and merged instead.
+*/
+#define SMALL_SORT_MAX 1024
+#define INSERTION_SORT_MAX 16
+/* Minimum number of elements per thread before the sort is split. */
+#define PARALLEL_SORT_MIN 65536
+
+struct sort_segment {
+  uint64_t *keys, *keys_out;
+  size_t *index, *index_out;
+  const size_t *bounds;
+  size_t n_runs, width;
+  size_t index_start, index_end;
+};
+
+static inline uint64_t double_to_key(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits & SIGN_BIT ? ~bits : bits | SIGN_BIT;
+}
+
+static inline double key_to_double(uint64_t key) {
+  uint64_t bits = key & SIGN_BIT ? key & ~SIGN_BIT : ~key;
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void insertion_sort(uint64_t *keys, size_t *index, size_t n) {
+  for (size_t i = 1; i < n; i++) {
+    uint64_t key = keys[i];
+    size_t position = index != NULL ? index[i] : 0;
+    size_t j = i;
+    for (; j > 0 && keys[j - 1] > key; j--) {
+      keys[j] = keys[j - 1];
+      if (index != NULL) index[j] = index[j - 1];
+    }
+    keys[j] = key;
+    if (index != NULL) index[j] = position;
+  }
+}
+
+/* Stable merge sort with the same contract as radix_sort, for small inputs. */
+static void small_sort(uint64_t *keys, uint64_t *temp, size_t *index, size_t *index_temp, size_t n) {
+  for (size_t lo = 0; lo < n; lo += INSERTION_SORT_MAX) {
+    size_t length = n - lo < INSERTION_SORT_MAX ? n - lo : INSERTION_SORT_MAX;
+    insertion_sort(keys + lo, index != NULL ? index + lo : NULL, length);
+  }
+
+  uint64_t *src = keys, *dst = temp;
+  size_t *index_src = index, *index_dst = index_temp;
+  for (size_t width = INSERTION_SORT_MAX; width < n; width *= 2) {
+    for (size_t lo = 0; lo < n; lo += 2 * width) {
+      size_t mid = lo + width < n ? lo + width : n;
+      size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+      size_t i = lo, j = mid;
+      for (size_t k = lo; k < hi; k++) {
+        size_t from = j == hi || (i < mid && src[i] <= src[j]) ? i++ : j++;
+        dst[k] = src[from];
+        if (index != NULL) index_dst[k] = index_src[from];
+      }
+    }
+    uint64_t *swap = src;
+    src = dst;
+    dst = swap;
+    size_t *index_swap = index_src;
+    index_src = index_dst;
+    index_dst = index_swap;
+  }
+
+  if (src != keys) {
+    memcpy(keys, src, sizeof(uint64_t) * n);
+    if (index != NULL) memcpy(index, index_src, sizeof(size_t) * n);
+  }
+}
+
+/*
+  The radix passes of radix_sort. Kept out of line so small sorts don't pay for
+  setting up the stack frame of the counters.
+*/
+__attribute__((noinline)) static void radix_passes(uint64_t *keys, uint64_t *temp, size_t *index,
+                                                   size_t *index_temp, size_t n) {
+  size_t counts[RADIX_PASSES][RADIX_BUCKETS] = {{0}};
+  for (size_t i = 0; i < n; i++) {
+    uint64_t key = keys[i];
+    for (size_t p = 0; p < RADIX_PASSES; p++) {
+      counts[p][(key >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  uint64_t *src = keys, *dst = temp;
+  size_t *index_src = index, *index_dst = index_temp;
+  for (size_t p = 0; p < RADIX_PASSES; p++) {
+    size_t shift = p * RADIX_BITS;
+    size_t *count = counts[p];
+    if (count[(src[0] >> shift) & (RADIX_BUCKETS - 1)] == n) continue;
+
+    size_t offset = 0;
+    for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+      size_t bucket = count[b];
+      count[b] = offset;
+      offset += bucket;
+    }
+
+    if (index != NULL) {
+      for (size_t i = 0; i < n; i++) {
+        size_t position = count[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+        dst[position] = src[i];
+        index_dst[position] = index_src[i];
+      }
+      size_t *swap = index_src;
+      index_src = index_dst;
+      index_dst = swap;
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        dst[count[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+      }
+    }
+    uint64_t *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if (src != keys) {
+    memcpy(keys, src, sizeof(uint64_t) * n);
+    if (index != NULL) memcpy(index, index_src, sizeof(size_t) * n);
+  }
+}
+
+/*
+  Sorts the n keys (and their indexes, when index is not NULL) stably, using temp
+  and index_temp as scratch of n elements each. The result is left in keys and index.
+*/
+static void radix_sort(uint64_t *keys, uint64_t *temp, size_t *index, size_t *index_temp, size_t n) {
+  if (n <= SMALL_SORT_MAX) {
+    small_sort(keys, temp, index, index_temp, n);
+  } else {
+    radix_passes(keys, temp, index, index_temp, n);
+  }
+}
+
+/*
+  Number of elements of the sorted runs a (m elements) and b (p elements) among the
+  first k of their stable merge, where ties are taken from a first.
+*/
+static size_t co_rank(const uint64_t *a, size_t m, const uint64_t *b, size_t p, size_t k) {
+  size_t lo = k > p ? k - p : 0;
+  size_t hi = k < m ? k : m;
+  while (lo < hi) {
+    size_t i = lo + (hi - lo) / 2;
+    if (a[i] <= b[k - i - 1]) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+/*
+  Writes the outputs [start, end) of the merge of the runs [lo, mid) and [mid, hi)
+  of the segment input into the same positions of its output.
+*/
+static void merge_range(const struct sort_segment *s, size_t lo, size_t mid, size_t hi, size_t start, size_t end) {
+  const uint64_t *a = s->keys + lo, *b = s->keys + mid;
+  size_t m = mid - lo, p = hi - mid;
+  size_t i = co_rank(a, m, b, p, start - lo), i_end = co_rank(a, m, b, p, end - lo);
+  size_t j = start - lo - i, j_end = end - lo - i_end;
+
+  uint64_t *keys_out = s->keys_out;
+  if (s->index != NULL) {
+    const size_t *a_index = s->index + lo, *b_index = s->index + mid;
+    for (size_t k = start; k < end; k++) {
+      if (j == j_end || (i < i_end && a[i] <= b[j])) {
+        keys_out[k] = a[i];
+        s->index_out[k] = a_index[i++];
+      } else {
+        keys_out[k] = b[j];
+        s->index_out[k] = b_index[j++];
+      }
+    }
+  } else {
+    for (size_t k = start; k < end; k++) {
+      keys_out[k] = j == j_end || (i < i_end && a[i] <= b[j]) ? a[i++] : b[j++];
+    }
+  }
+}
+
+/* Radix sorts the run index_start, using the output buffers as scratch. */
+static void *sort_run_worker(void *arg) {
+  struct sort_segment *s = (struct sort_segment *)arg;
+  PROFILE_MARK(chunk_start);
+  size_t lo = s->bounds[s->index_start], n = s->bounds[s->index_start + 1] - lo;
+  radix_sort(s->keys + lo, s->keys_out + lo, s->index != NULL ? s->index + lo : NULL,
+             s->index != NULL ? s->index_out + lo : NULL, n);
+  PROFILE_CHUNK(s->index != NULL ? PROFILE_ARGSORT : PROFILE_SORT, chunk_start);
+  return NULL;
+}
+
+/* Writes the outputs [index_start, index_end) of one round of pairwise merges. */
+static void *merge_round_worker(void *arg) {
+  struct sort_segment *s = (struct sort_segment *)arg;
+  PROFILE_MARK(chunk_start);
+  for (size_t run = 0; run < s->n_runs; run += 2 * s->width) {
+    size_t lo = s->bounds[run];
+    size_t mid = s->bounds[run + s->width < s->n_runs ? run + s->width : s->n_runs];
+    size_t hi = s->bounds[run + 2 * s->width < s->n_runs ? run + 2 * s->width : s->n_runs];
+    size_t start = lo > s->index_start ? lo : s->index_start;
+    size_t end = hi < s->index_end ? hi : s->index_end;
+    if (start < end) merge_range(s, lo, mid, hi, start, end);
+  }
+  PROFILE_CHUNK(s->index != NULL ? PROFILE_ARGSORT : PROFILE_SORT, chunk_start);
+  return NULL;
+}
+
+static int run_sort_segments(void *(*func)(void *), struct sort_segment *segments, size_t num_threads) {
+  pthread_t threads[num_threads];
+  size_t created = 0;
+  int status = 0;
+
+  for (; created < num_threads; created++) {
+    if (memory_thread_create(&threads[created], func, &segments[created]) != 0) {
+      status = -1;
+      break;
+    }
+  }
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  return status;
+}
+
+/*
+  Sorts the n keys, carrying their indexes along when index is not NULL.
+  Returns 0 if successfull, Return -1 if not.
+*/
+static int sort_keys(uint64_t *keys, size_t *index, size_t n, size_t n_threads, enum profile_id id) {
+  PROFILE_MARK(alloc_start);
+  uint64_t *keys_temp;
+  size_t *index_temp = NULL;
+  if (posix_memalign((void **)&keys_temp, 64, sizeof(uint64_t) * n) != 0) return -1;
+  if (index != NULL && posix_memalign((void **)&index_temp, 64, sizeof(size_t) * n) != 0) {
+    free(keys_temp);
+    return -1;
+  }
+  PROFILE_PHASE(id, PROFILE_PHASE_ALLOC, alloc_start);
+
+  size_t num_threads = n_threads < n / PARALLEL_SORT_MIN ? n_threads : n / PARALLEL_SORT_MIN;
+  if (num_threads < 2) {
+    radix_sort(keys, keys_temp, index, index_temp, n);
+    free(keys_temp);
+    free(index_temp);
+    return 0;
+  }
+
+  size_t bounds[num_threads + 1];
+  struct sort_segment segments[num_threads];
+  size_t step = n / num_threads;
+  size_t remaining = n % num_threads;
+  bounds[0] = 0;
+  for (size_t i = 0; i < num_threads; i++) {
+    bounds[i + 1] = bounds[i] + step + (i < remaining ? 1 : 0);
+    segments[i] = (struct sort_segment){
+      .keys = keys, .keys_out = keys_temp, .index = index, .index_out = index_temp,
+      .bounds = bounds, .n_runs = num_threads, .index_start = i
+    };
+  }
+
+  PROFILE_MARK(spawn_start);
+  int status = run_sort_segments(sort_run_worker, segments, num_threads);
+  PROFILE_PHASE(id, PROFILE_PHASE_SPAWN, spawn_start);
+
+  uint64_t *keys_in = keys, *keys_out = keys_temp;
+  size_t *index_in = index, *index_out = index_temp;
+  for (size_t width = 1; width < num_threads && status == 0; width *= 2) {
+    for (size_t i = 0; i < num_threads; i++) {
+      segments[i].keys = keys_in;
+      segments[i].keys_out = keys_out;
+      segments[i].index = index_in;
+      segments[i].index_out = index_out;
+      segments[i].width = width;
+      segments[i].index_start = bounds[i];
+      segments[i].index_end = bounds[i + 1];
+    }
+    status = run_sort_segments(merge_round_worker, segments, num_threads);
+
+    uint64_t *keys_swap = keys_in;
+    keys_in = keys_out;
+    keys_out = keys_swap;
+    size_t *index_swap = index_in;
+    index_in = index_out;
+    index_out = index_swap;
+  }
+
+  if (status == 0 && keys_in != keys) {
+    memcpy(keys, keys_in, sizeof(uint64_t) * n);
+    if (index != NULL) memcpy(index, index_in, sizeof(size_t) * n);
+  }
+
+  free(keys_temp);
+  free(index_temp);
+  return status;
+}
+
+int amath_sort(double *data, size_t n_elements, size_t n_threads) {
+  if (data == NULL || n_threads == 0) return -1;
+  if (n_elements < 2) return 0;
+  PROFILE_BEGIN(scope);
+
+  uint64_t *keys;
+  if (posix_memalign((void **)&keys, 64, sizeof(uint64_t) * n_elements) != 0) return -1;
+
+  size_t count = 0;
+  for (size_t i = 0; i < n_elements; i++) {
+    if (!isnan(data[i])) keys[count++] = double_to_key(data[i]);
+  }
+
+  /*
+    NaNs are left out of the sort and moved to the end in their original order. data is
+    only written once the keys are sorted, so it is left untouched on error.
+  */
+  int status = sort_keys(keys, NULL, count, n_threads, PROFILE_SORT);
+  if (status == 0) {
+    for (size_t i = n_elements, tail = n_elements; i-- > 0 && tail > count;) {
+      if (isnan(data[i])) data[--tail] = data[i];
+    }
+    for (size_t i = 0; i < count; i++) data[i] = key_to_double(keys[i]);
+  }
+
+  free(keys);
+  PROFILE_CALL(scope, PROFILE_SORT, sizeof(double) * n_elements);
+  return status;
+}
+
+int amath_argsort(double *data, size_t n_elements, size_t *order, size_t n_threads) {
+  if (data == NULL || order == NULL || n_threads == 0) return -1;
+  PROFILE_BEGIN(scope);
+
+  uint64_t *keys;
+  if (posix_memalign((void **)&keys, 64, sizeof(uint64_t) * (n_elements > 0 ? n_elements : 1)) != 0) {
+    return -1;
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < n_elements; i++) {
+    if (!isnan(data[i])) {
+      keys[count] = double_to_key(data[i]);
+      order[count++] = i;
+    }
+  }
+  for (size_t i = 0, tail = count; i < n_elements; i++) {
+    if (isnan(data[i])) order[tail++] = i;
+  }
+
+  int status = sort_keys(keys, order, count, n_threads, PROFILE_ARGSORT);
+
+  free(keys);
+  PROFILE_CALL(scope, PROFILE_ARGSORT, sizeof(double) * n_elements);
+  return status;
+}
@@ -3,15 +3,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-static int sort_function(const void *a, const void *b) {
-  double first = *(double*)a;
-  double second = *(double*)b;
-
-  if (first > second) return -1;
-  if (second > first) return 1;
-  return 0;
-}
-
 double amath_mean(double* restrict data, size_t n_elements) {
   if (data == NULL || n_elements == 0) return NAN;
 
@@ -25,7 +16,7 @@ double amath_mean(double* restrict data, size_t n_elements) {
 double amath_median(double* restrict data, size_t n_elements, unsigned int sorted) {
   if (data == NULL || n_elements <= 0) return NAN;
 
-  if (!sorted) qsort(data, n_elements, sizeof(double), sort_function);
+  if (!sorted && amath_sort(data, n_elements, 1) != 0) return NAN;
 
   if (n_elements % 2 > 0) {
     return data[(n_elements - 1) / 2];
@@ -132,3 +123,98 @@ double amath_variance(double* data, size_t n_elements) {
   return amath_covariance(data, data, 1, n_elements);
 }
 
+/*
+  Single precision variants. Sums are accumulated in double over REDUCTION_LANES
+  independent partial sums, which keeps the accuracy of the double versions while
+  letting the compiler vectorise the loops without reassociating them.
+*/
+#define REDUCTION_LANES 16
+
+double amath_meanf(float* restrict data, size_t n_elements) {
+  if (data == NULL || n_elements == 0) return NAN;
+
+  double partial[REDUCTION_LANES] = {0};
+  size_t blocks = n_elements - n_elements % REDUCTION_LANES;
+  for (size_t i = 0; i < blocks; i += REDUCTION_LANES) {
+    for (size_t j = 0; j < REDUCTION_LANES; j++) partial[j] += data[i + j];
+  }
+
+  double mean = 0;
+  for (size_t i = blocks; i < n_elements; i++) mean += data[i];
+  for (size_t j = 0; j < REDUCTION_LANES; j++) mean += partial[j];
+  return mean / n_elements;
+}
+
+static double co_moment_f(float* data, float* other, double xmean, double ymean, size_t n_elements) {
+  double partial[REDUCTION_LANES] = {0};
+  size_t blocks = n_elements - n_elements % REDUCTION_LANES;
+  for (size_t i = 0; i < blocks; i += REDUCTION_LANES) {
+    for (size_t j = 0; j < REDUCTION_LANES; j++) {
+      partial[j] += (data[i + j] - xmean) * (other[i + j] - ymean);
+    }
+  }
+
+  double sum = 0;
+  for (size_t i = blocks; i < n_elements; i++) sum += (data[i] - xmean) * (other[i] - ymean);
+  for (size_t j = 0; j < REDUCTION_LANES; j++) sum += partial[j];
+  return sum;
+}
+
+double amath_stdevf(float* restrict data, unsigned int population, size_t n_elements) {
+  if (data == NULL || n_elements == 0) return NAN;
+  int bessel_correction = population ? 0 : 1;
+
+  double data_mean = amath_meanf(data, n_elements);
+  return sqrt(co_moment_f(data, data, data_mean, data_mean, n_elements) / (n_elements - bessel_correction));
+}
+
+float amath_minf(float* restrict data, size_t n_elements) {
+  if (data == NULL || n_elements == 0) return NAN;
+  float min = data[0];
+  for (size_t i = 1; i < n_elements; i++) {
+    min = data[i] < min ? data[i] : min;
+  }
+  return min;
+}
+
+float amath_maxf(float* restrict data, size_t n_elements) {
+  if (data == NULL || n_elements == 0) return NAN;
+  float max = data[0];
+  for (size_t i = 1; i < n_elements; i++) {
+    max = data[i] > max ? data[i] : max;
+  }
+  return max;
+}
+
+float amath_rangef(float* restrict data, size_t n_elements) {
+  if (data == NULL || n_elements < 1) return NAN;
+  return amath_maxf(data, n_elements) - amath_minf(data, n_elements);
+}
+
+double amath_covariancef(float* data, float* other, unsigned int population, size_t n_elements) {
+  if (data == NULL || other == NULL || n_elements < 1) return NAN;
+  double xmean = amath_meanf(data, n_elements);
+  double ymean = amath_meanf(other, n_elements);
+
+  if (isnan(xmean) || isnan(ymean)) return NAN;
+
+  unsigned int bessel_correction = population ? 0 : 1;
+  return co_moment_f(data, other, xmean, ymean, n_elements) / (n_elements - bessel_correction);
+}
+
+double amath_pcorrf(float* restrict data, float* restrict other, size_t n_elements) {
+  if (data == NULL || other == NULL || n_elements < 1) return NAN;
+  double covariance = amath_covariancef(data, other, 1, n_elements);
+  double xstdev = amath_stdevf(data, 1, n_elements);
+  double ystdev = amath_stdevf(other, 1, n_elements);
+
+  if (isnan(xstdev) || isnan(ystdev) || isnan(covariance)) return NAN;
+  if (xstdev == 0 || ystdev == 0) return NAN;
+
+  return covariance / (xstdev * ystdev);
+}
+
+double amath_variancef(float* data, size_t n_elements) {
+  if (data == NULL || n_elements < 1) return NAN;
+  return amath_covariancef(data, data, 1, n_elements);
+}
@@ -1,4 +1,7 @@
 #include "../amath.h"
+#include "statistics.h"
+#include <math.h>
+#include <string.h>
 
 typedef struct Data {
   double *x;
@@ -36,3 +39,79 @@ double amath_kcorr(double *data1, double *data2, size_t size) {
   free(data);
   return t;
 }
+
+#define pairs_in_run(length) ((double)(length) * ((length) - 1) / 2)
+
+double kendall_tie_pairs(const double *data, const size_t *order, size_t n) {
+  double pairs = 0;
+  size_t run = 1;
+  for (size_t i = 1; i < n; i++) {
+    if (data[order[i]] == data[order[i - 1]]) {
+      run++;
+    } else {
+      pairs += pairs_in_run(run);
+      run = 1;
+    }
+  }
+  return pairs + pairs_in_run(run);
+}
+
+/*
+  Bottom-up merge sort of values, returning the number of strictly inverted pairs.
+*/
+static double merge_count_inversions(double *values, double *temp, size_t n) {
+  double swaps = 0;
+  for (size_t width = 1; width < n; width *= 2) {
+    for (size_t lo = 0; lo + width < n; lo += 2 * width) {
+      size_t mid = lo + width;
+      size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+      size_t i = lo, j = mid, k = lo;
+
+      while (i < mid && j < hi) {
+        if (values[j] < values[i]) {
+          swaps += mid - i;
+          temp[k++] = values[j++];
+        } else {
+          temp[k++] = values[i++];
+        }
+      }
+      while (i < mid) temp[k++] = values[i++];
+      while (j < hi) temp[k++] = values[j++];
+      memcpy(values + lo, temp + lo, sizeof(double) * (hi - lo));
+    }
+  }
+  return swaps;
+}
+
+double kendall_tau_sorted(const double *x, const double *y, const size_t *x_order, size_t n,
+                          double x_tie_pairs, double y_tie_pairs, double *buffer) {
+  double *ys = buffer, *temp = buffer + n;
+  for (size_t k = 0; k < n; k++) {
+    ys[k] = y[x_order[k]];
+  }
+
+  /* Sort y inside every run of tied x, counting the pairs tied in both arrays. */
+  double joint_tie_pairs = 0;
+  size_t start = 0;
+  for (size_t k = 1; k <= n; k++) {
+    if (k < n && x[x_order[k]] == x[x_order[start]]) continue;
+    if (k - start > 1) {
+      if (amath_sort(ys + start, k - start, 1) != 0) return NAN;
+      size_t run = 1;
+      for (size_t i = start + 1; i < k; i++) {
+        if (ys[i] == ys[i - 1]) {
+          run++;
+        } else {
+          joint_tie_pairs += pairs_in_run(run);
+          run = 1;
+        }
+      }
+      joint_tie_pairs += pairs_in_run(run);
+    }
+    start = k;
+  }
+
+  double discordant = merge_count_inversions(ys, temp, n);
+  double total_pairs = pairs_in_run(n);
+  return (total_pairs - x_tie_pairs - y_tie_pairs + joint_tie_pairs - 2 * discordant) / total_pairs;
+}
@@ -0,0 +1,311 @@
+#include "../amath.h"
+#include "statistics.h"
+#include "../memory/memory.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  The Gram matrix Z^T Z of the standardised series is computed in SERIES_BLOCK x
+  SERIES_BLOCK tiles of the upper triangle, walking the observations in OBS_BLOCK
+  chunks so both blocks of series stay in cache. Inside a tile, a MICRO x MICRO
+  register kernel accumulates over LANES independent partial sums so it vectorises.
+*/
+#define SERIES_BLOCK 32
+#define OBS_BLOCK 256
+#define MICRO 2
+#define LANES 8
+
+struct matrix_segment {
+  const double *z;
+  const double *data;
+  const size_t *orders;
+  const double *tie_pairs;
+  size_t n_obs, n_series, padded_obs;
+  double divisor;
+  double *result;
+  size_t index_start, index_end;
+  int status;
+};
+
+static void micro_kernel(const double *z, size_t padded_obs, size_t i, size_t j, size_t k0, size_t k1,
+                         double *acc) {
+  const double *a[MICRO], *b[MICRO];
+  for (size_t p = 0; p < MICRO; p++) {
+    a[p] = z + (i + p) * padded_obs;
+    b[p] = z + (j + p) * padded_obs;
+  }
+
+  double sum[MICRO][MICRO][LANES] = {{{0}}};
+  for (size_t k = k0; k < k1; k += LANES) {
+    for (size_t p = 0; p < MICRO; p++) {
+      for (size_t q = 0; q < MICRO; q++) {
+        for (size_t l = 0; l < LANES; l++) {
+          sum[p][q][l] += a[p][k + l] * b[q][k + l];
+        }
+      }
+    }
+  }
+
+  for (size_t p = 0; p < MICRO; p++) {
+    for (size_t q = 0; q < MICRO; q++) {
+      double total = 0;
+      for (size_t l = 0; l < LANES; l++) total += sum[p][q][l];
+      acc[p * SERIES_BLOCK + q] += total;
+    }
+  }
+}
+
+static void gram_tile(const struct matrix_segment *s, size_t block_i, size_t block_j, double *acc) {
+  size_t i0 = block_i * SERIES_BLOCK, j0 = block_j * SERIES_BLOCK;
+  size_t i1 = i0 + SERIES_BLOCK < s->n_series ? i0 + SERIES_BLOCK : s->n_series;
+  size_t j1 = j0 + SERIES_BLOCK < s->n_series ? j0 + SERIES_BLOCK : s->n_series;
+  memset(acc, 0, sizeof(double) * SERIES_BLOCK * SERIES_BLOCK);
+
+  for (size_t k0 = 0; k0 < s->padded_obs; k0 += OBS_BLOCK) {
+    size_t k1 = k0 + OBS_BLOCK < s->padded_obs ? k0 + OBS_BLOCK : s->padded_obs;
+    for (size_t i = i0; i < i1; i += MICRO) {
+      for (size_t j = block_i == block_j ? i : j0; j < j1; j += MICRO) {
+        micro_kernel(s->z, s->padded_obs, i, j, k0, k1, acc + (i - i0) * SERIES_BLOCK + (j - j0));
+      }
+    }
+  }
+
+  for (size_t i = i0; i < i1; i++) {
+    for (size_t j = block_i == block_j ? i : j0; j < j1; j++) {
+      s->result[AMATH_PACKED_INDEX(i, j, s->n_series)] = acc[(i - i0) * SERIES_BLOCK + (j - j0)] / s->divisor;
+    }
+  }
+}
+
+/* Computes the tiles [index_start, index_end) of the upper triangle, in row order. */
+static void *gram_segment(void *arg) {
+  struct matrix_segment *s = (struct matrix_segment *)arg;
+  size_t blocks = (s->n_series + SERIES_BLOCK - 1) / SERIES_BLOCK;
+
+  double *acc;
+  if (posix_memalign((void **)&acc, 64, sizeof(double) * SERIES_BLOCK * SERIES_BLOCK) != 0) {
+    s->status = -1;
+    return NULL;
+  }
+
+  size_t block_i = 0, block_j = 0, tile = 0;
+  while (tile + (blocks - block_i) <= s->index_start) {
+    tile += blocks - block_i;
+    block_i++;
+  }
+  block_j = block_i + (s->index_start - tile);
+
+  for (tile = s->index_start; tile < s->index_end; tile++) {
+    gram_tile(s, block_i, block_j, acc);
+    if (++block_j == blocks) {
+      block_i++;
+      block_j = block_i;
+    }
+  }
+
+  free(acc);
+  return NULL;
+}
+
+/* Computes the packed entries [index_start, index_end) with Kendall's tau. */
+static void *kendall_segment(void *arg) {
+  struct matrix_segment *s = (struct matrix_segment *)arg;
+  size_t n = s->n_obs, n_series = s->n_series;
+
+  double *buffer = malloc(sizeof(double) * n * 2);
+  if (buffer == NULL) {
+    s->status = -1;
+    return NULL;
+  }
+
+  size_t i = 0, index = 0;
+  while (index + (n_series - i) <= s->index_start) {
+    index += n_series - i;
+    i++;
+  }
+  size_t j = i + (s->index_start - index);
+  double total_pairs = (double)n * (n - 1) / 2;
+
+  for (index = s->index_start; index < s->index_end; index++) {
+    if (i == j) {
+      s->result[index] = (total_pairs - s->tie_pairs[i]) / total_pairs;
+    } else {
+      s->result[index] = kendall_tau_sorted(s->data + i * n, s->data + j * n, s->orders + i * n, n,
+                                            s->tie_pairs[i], s->tie_pairs[j], buffer);
+    }
+    if (++j == n_series) {
+      i++;
+      j = i;
+    }
+  }
+
+  free(buffer);
+  return NULL;
+}
+
+static int run_matrix_segments(void *(*func)(void *), const struct matrix_segment *base, size_t units,
+                               size_t n_threads) {
+  size_t num_threads = n_threads <= units ? n_threads : units;
+  struct matrix_segment *segments;
+  if (posix_memalign((void **)&segments, 64, sizeof(struct matrix_segment) * num_threads) != 0) {
+    return -1;
+  }
+
+  pthread_t threads[num_threads];
+  size_t step = units / num_threads;
+  size_t remaining = units % num_threads;
+  size_t position = 0, created = 0;
+  int status = 0;
+
+  for (; created < num_threads; created++) {
+    segments[created] = *base;
+    segments[created].index_start = position;
+    position += step + (created < remaining ? 1 : 0);
+    segments[created].index_end = position;
+
+    if (memory_thread_create(&threads[created], func, &segments[created]) != 0) {
+      status = -1;
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+    if (segments[i].status != 0) status = -1;
+  }
+
+  free(segments);
+  return status;
+}
+
+/*
+  Centres every series once (and scales it to unit norm when normalize is set) into
+  a buffer padded with zero observations and zero series up to the kernel sizes,
+  then computes the Gram matrix divided by divisor.
+*/
+static double *gram_matrix(double *data, size_t n_obs, size_t n_series, int normalize, double divisor,
+                           size_t n_threads) {
+  size_t packed = n_series * (n_series + 1) / 2;
+  size_t padded_obs = (n_obs + LANES - 1) / LANES * LANES;
+  size_t padded_series = (n_series + MICRO - 1) / MICRO * MICRO;
+
+  double *result;
+  if (posix_memalign((void **)&result, 64, sizeof(double) * packed) != 0) {
+    return NULL;
+  }
+
+  double *z;
+  if (posix_memalign((void **)&z, 64, sizeof(double) * padded_obs * padded_series) != 0) {
+    free(result);
+    return NULL;
+  }
+  memset(z, 0, sizeof(double) * padded_obs * padded_series);
+
+  for (size_t s = 0; s < n_series; s++) {
+    const double *x = data + s * n_obs;
+    double *column = z + s * padded_obs;
+    double mean = amath_mean(data + s * n_obs, n_obs);
+    double squares = 0;
+    for (size_t k = 0; k < n_obs; k++) {
+      column[k] = x[k] - mean;
+      squares += column[k] * column[k];
+    }
+    if (normalize) {
+      double scale = squares > 0 ? 1 / sqrt(squares) : NAN;
+      for (size_t k = 0; k < n_obs; k++) column[k] *= scale;
+    }
+  }
+
+  size_t blocks = (n_series + SERIES_BLOCK - 1) / SERIES_BLOCK;
+  struct matrix_segment base = {
+    .z = z, .n_obs = n_obs, .n_series = n_series, .padded_obs = padded_obs,
+    .divisor = divisor, .result = result, .status = 0
+  };
+  int status = run_matrix_segments(gram_segment, &base, blocks * (blocks + 1) / 2, n_threads);
+
+  free(z);
+  if (status != 0) {
+    free(result);
+    return NULL;
+  }
+  return result;
+}
+
+static double *kendall_matrix(double *data, size_t n_obs, size_t n_series, size_t n_threads) {
+  size_t packed = n_series * (n_series + 1) / 2;
+
+  double *result;
+  if (posix_memalign((void **)&result, 64, sizeof(double) * packed) != 0) {
+    return NULL;
+  }
+  size_t *orders = malloc(sizeof(size_t) * n_obs * n_series);
+  double *tie_pairs = malloc(sizeof(double) * n_series);
+  if (orders == NULL || tie_pairs == NULL) {
+    free(orders);
+    free(tie_pairs);
+    free(result);
+    return NULL;
+  }
+
+  /* Every series is sorted once, however many pairs it takes part in. */
+  int status = 0;
+  for (size_t s = 0; s < n_series && status == 0; s++) {
+    status = amath_argsort(data + s * n_obs, n_obs, orders + s * n_obs, n_threads);
+    if (status == 0) tie_pairs[s] = kendall_tie_pairs(data + s * n_obs, orders + s * n_obs, n_obs);
+  }
+
+  if (status == 0) {
+    struct matrix_segment base = {
+      .data = data, .orders = orders, .tie_pairs = tie_pairs,
+      .n_obs = n_obs, .n_series = n_series, .result = result, .status = 0
+    };
+    status = run_matrix_segments(kendall_segment, &base, packed, n_threads);
+  }
+
+  free(orders);
+  free(tie_pairs);
+  if (status != 0) {
+    free(result);
+    return NULL;
+  }
+  return result;
+}
+
+/* Spearman's rho is Pearson's correlation of the ranks, so every series is ranked once. */
+static double *spearman_matrix(double *data, size_t n_obs, size_t n_series, size_t n_threads) {
+  double *ranks = malloc(sizeof(double) * n_obs * n_series);
+  if (ranks == NULL) return NULL;
+
+  int status = 0;
+  for (size_t s = 0; s < n_series && status == 0; s++) {
+    status = statistics_rank_values(data + s * n_obs, n_obs, ranks + s * n_obs, n_threads);
+  }
+
+  double *result = status == 0 ? gram_matrix(ranks, n_obs, n_series, 1, 1.0, n_threads) : NULL;
+  free(ranks);
+  return result;
+}
+
+double *amath_cov_matrix(double *data, size_t n_elements, size_t n_series, unsigned int population,
+                         size_t n_threads) {
+  if (data == NULL || n_elements < 1 || n_series == 0 || n_threads == 0) return NULL;
+  unsigned int bessel_correction = population ? 0 : 1;
+  return gram_matrix(data, n_elements, n_series, 0, (double)n_elements - bessel_correction, n_threads);
+}
+
+double *amath_corr_matrix(double *data, size_t n_elements, size_t n_series, CorrelationMethod method,
+                          size_t n_threads) {
+  if (data == NULL || n_elements < 2 || n_series == 0 || n_threads == 0) return NULL;
+
+  switch (method) {
+    case AMATH_CORR_PEARSON:
+      return gram_matrix(data, n_elements, n_series, 1, 1.0, n_threads);
+    case AMATH_CORR_KENDALL:
+      return kendall_matrix(data, n_elements, n_series, n_threads);
+    case AMATH_CORR_SPEARMAN:
+      return spearman_matrix(data, n_elements, n_series, n_threads);
+  }
+  return NULL;
+}
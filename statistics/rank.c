@@ -0,0 +1,124 @@
+#include "../amath.h"
+#include "statistics.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define REDUCTION_LANES 16
+
+/*
+  Assigns average ranks from the order that sorts data and fills the tie statistics
+  of the handle. With t elements in every run of ties, the squared deviations of the
+  ranks from their mean (n + 1) / 2 sum to ((n^3 - n) - sum(t^3 - t)) / 12.
+*/
+static void assign_ranks(Ranks *ranks, double *data) {
+  size_t n = ranks->n_elements;
+  const size_t *order = ranks->order;
+  double tie_pairs = 0, tie_cubes = 0;
+
+  size_t start = 0;
+  for (size_t k = 1; k <= n; k++) {
+    if (k < n && data[order[k]] == data[order[start]]) continue;
+    double run = (double)(k - start);
+    double rank = (start + 1 + k) / 2.0;
+    for (size_t i = start; i < k; i++) {
+      ranks->ranks[order[i]] = rank;
+    }
+    tie_pairs += run * (run - 1) / 2;
+    tie_cubes += run * run * run - run;
+    start = k;
+  }
+
+  double size = (double)n;
+  ranks->tie_pairs = tie_pairs;
+  ranks->sum_squares = (size * size * size - size - tie_cubes) / 12;
+}
+
+int statistics_rank_values(double *data, size_t n, double *ranks, size_t n_threads) {
+  size_t *order = malloc(sizeof(size_t) * n);
+  if (order == NULL) return -1;
+
+  int status = amath_argsort(data, n, order, n_threads);
+  if (status == 0) {
+    Ranks handle = {.ranks = ranks, .order = order, .n_elements = n};
+    assign_ranks(&handle, data);
+  }
+
+  free(order);
+  return status;
+}
+
+Ranks *amath_rank(double *data, size_t n_elements, size_t n_threads) {
+  if (data == NULL || n_elements == 0 || n_threads == 0) return NULL;
+
+  Ranks *ranks = malloc(sizeof(Ranks));
+  if (ranks == NULL) return NULL;
+  ranks->n_elements = n_elements;
+  ranks->ranks = malloc(sizeof(double) * n_elements);
+  ranks->order = malloc(sizeof(size_t) * n_elements);
+
+  if (ranks->ranks == NULL || ranks->order == NULL || amath_rerank(ranks, data, n_threads) != 0) {
+    amath_destroy_ranks(ranks);
+    return NULL;
+  }
+  return ranks;
+}
+
+int amath_rerank(Ranks *ranks, double *data, size_t n_threads) {
+  if (ranks == NULL || data == NULL || n_threads == 0) return -1;
+  if (amath_argsort(data, ranks->n_elements, ranks->order, n_threads) != 0) return -1;
+  assign_ranks(ranks, data);
+  return 0;
+}
+
+void amath_destroy_ranks(Ranks *ranks) {
+  if (ranks == NULL) return;
+  free(ranks->ranks);
+  free(ranks->order);
+  free(ranks);
+}
+
+double amath_scorr_ranked(const Ranks *x, const Ranks *y) {
+  if (x == NULL || y == NULL || x->n_elements != y->n_elements || x->n_elements < 2) return NAN;
+  if (x->sum_squares == 0 || y->sum_squares == 0) return NAN;
+
+  size_t n = x->n_elements;
+  double mean = (n + 1) / 2.0;
+  double partial[REDUCTION_LANES] = {0};
+  size_t blocks = n - n % REDUCTION_LANES;
+  for (size_t i = 0; i < blocks; i += REDUCTION_LANES) {
+    for (size_t j = 0; j < REDUCTION_LANES; j++) {
+      partial[j] += (x->ranks[i + j] - mean) * (y->ranks[i + j] - mean);
+    }
+  }
+
+  double sum = 0;
+  for (size_t i = blocks; i < n; i++) sum += (x->ranks[i] - mean) * (y->ranks[i] - mean);
+  for (size_t j = 0; j < REDUCTION_LANES; j++) sum += partial[j];
+  return sum / sqrt(x->sum_squares * y->sum_squares);
+}
+
+double amath_kcorr_ranked(const Ranks *x, const Ranks *y) {
+  if (x == NULL || y == NULL || x->n_elements != y->n_elements || x->n_elements < 2) return NAN;
+
+  size_t n = x->n_elements;
+  double *buffer = malloc(sizeof(double) * n * 2);
+  if (buffer == NULL) return NAN;
+
+  /* Ranks are tied exactly where the data is, so they stand in for the values. */
+  double tau = kendall_tau_sorted(x->ranks, y->ranks, x->order, n, x->tie_pairs, y->tie_pairs, buffer);
+
+  free(buffer);
+  return tau;
+}
+
+double amath_scorr(double *data1, double *data2, size_t n_elements) {
+  if (data1 == NULL || data2 == NULL || n_elements < 2) return NAN;
+
+  Ranks *x = amath_rank(data1, n_elements, 1);
+  Ranks *y = amath_rank(data2, n_elements, 1);
+  double rho = x != NULL && y != NULL ? amath_scorr_ranked(x, y) : NAN;
+
+  amath_destroy_ranks(x);
+  amath_destroy_ranks(y);
+  return rho;
+}
@@ -0,0 +1,352 @@
+#include "../amath.h"
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  KLL sketch (Karnin, Lang and Liberty). Level h holds items standing for 2^h
+  values each. Level 0 receives the stream unsorted, the other levels are sorted.
+  When the sketch reaches its capacity, the lowest level at or over its own
+  capacity is sorted and compacted: a random half of its items (every other one,
+  starting at a random parity) is promoted to the next level, the rest dropped.
+  Level h has capacity k * (2/3)^(depth) with depth counted from the top level,
+  so the total stays below 3k items however long the stream is.
+*/
+#define SKETCH_DEFAULT_K 200
+#define SKETCH_MIN_K 8
+#define SKETCH_MAX_K 65535
+#define SKETCH_MIN_WIDTH 8
+#define SKETCH_MAX_LEVELS 60
+#define SKETCH_MAGIC 0x31534b41u  // "AKS1"
+
+struct QuantileSketch {
+  unsigned int k;
+  size_t n_levels;
+  unsigned long long count;
+  double min, max;
+  uint64_t random;
+  size_t n_items, capacity;
+  double *levels[SKETCH_MAX_LEVELS];
+  size_t sizes[SKETCH_MAX_LEVELS], allocated[SKETCH_MAX_LEVELS], capacities[SKETCH_MAX_LEVELS];
+};
+
+/* Serialised header, followed by n_levels uint32 level sizes and the items, level by level. */
+struct sketch_header {
+  uint32_t magic, k, n_levels, reserved;
+  unsigned long long count;
+  double min, max;
+  uint64_t random;
+};
+
+/* Sets the number of levels and recomputes the level capacities, which depend on it. */
+static void set_levels(QuantileSketch *s, size_t n_levels) {
+  s->n_levels = n_levels;
+  s->capacity = 0;
+  for (size_t h = 0; h < n_levels; h++) {
+    double capacity = ceil(s->k * pow(2.0 / 3.0, (double)(n_levels - 1 - h)));
+    s->capacities[h] = capacity > SKETCH_MIN_WIDTH ? (size_t)capacity : SKETCH_MIN_WIDTH;
+    s->capacity += s->capacities[h];
+  }
+}
+
+static int reserve_level(QuantileSketch *s, size_t level, size_t size) {
+  if (size <= s->allocated[level]) return 0;
+  size_t allocated = s->allocated[level] * 2 > size ? s->allocated[level] * 2 : size;
+  double *items = realloc(s->levels[level], sizeof(double) * allocated);
+  if (items == NULL) return -1;
+  s->levels[level] = items;
+  s->allocated[level] = allocated;
+  return 0;
+}
+
+static int next_random_bit(QuantileSketch *s) {
+  s->random ^= s->random << 13;
+  s->random ^= s->random >> 7;
+  s->random ^= s->random << 17;
+  return (int)(s->random >> 63);
+}
+
+/* Merges the n sorted items into the sorted level, from the back so it works in place. */
+static int merge_into_level(QuantileSketch *s, size_t level, const double *items, size_t n) {
+  size_t size = s->sizes[level];
+  if (reserve_level(s, level, size + n) != 0) return -1;
+
+  double *out = s->levels[level];
+  size_t i = size, j = n, k = size + n;
+  while (j > 0) {
+    if (i > 0 && out[i - 1] > items[j - 1]) {
+      out[--k] = out[--i];
+    } else {
+      out[--k] = items[--j];
+    }
+  }
+  s->sizes[level] = size + n;
+  s->n_items += n;
+  return 0;
+}
+
+static int compact_level(QuantileSketch *s, size_t level) {
+  if (level + 1 == s->n_levels) {
+    if (s->n_levels == SKETCH_MAX_LEVELS) return -1;
+    set_levels(s, s->n_levels + 1);
+  }
+
+  double *items = s->levels[level];
+  size_t size = s->sizes[level];
+  if (level == 0 && amath_sort(items, size, 1) != 0) return -1;
+
+  /* With an odd number of items, the smallest stays behind. */
+  size_t start = size % 2, promoted = (size - start) / 2;
+  size_t offset = start + next_random_bit(s);
+  for (size_t i = 0; i < promoted; i++) {
+    items[start + i] = items[offset + 2 * i];
+  }
+
+  if (merge_into_level(s, level + 1, items + start, promoted) != 0) return -1;
+  s->n_items -= size - start;
+  s->sizes[level] = start;
+  return 0;
+}
+
+/* Compacts the lowest levels over capacity until the sketch fits its total capacity. */
+static int compress(QuantileSketch *s) {
+  while (s->n_items >= s->capacity) {
+    size_t level = 0;
+    while (level + 1 < s->n_levels && s->sizes[level] < s->capacities[level]) level++;
+    if (compact_level(s, level) != 0) return -1;
+  }
+  return 0;
+}
+
+QuantileSketch *amath_sketch_create(unsigned int k) {
+  if (k == 0) k = SKETCH_DEFAULT_K;
+  if (k < SKETCH_MIN_K || k > SKETCH_MAX_K) return NULL;
+
+  QuantileSketch *s = calloc(1, sizeof(QuantileSketch));
+  if (s == NULL) return NULL;
+  s->k = k;
+  set_levels(s, 1);
+  s->min = NAN;
+  s->max = NAN;
+  s->random = 0x9e3779b97f4a7c15ULL;
+  return s;
+}
+
+void amath_destroy_sketch(QuantileSketch *sketch) {
+  if (sketch == NULL) return;
+  for (size_t h = 0; h < SKETCH_MAX_LEVELS; h++) free(sketch->levels[h]);
+  free(sketch);
+}
+
+int amath_sketch_update(QuantileSketch *sketch, double *data, size_t n_elements) {
+  if (sketch == NULL || data == NULL) return -1;
+
+  size_t i = 0;
+  while (i < n_elements) {
+    /* Values are copied in bulk up to the room left before the next compaction. */
+    size_t room = sketch->capacity - sketch->n_items;
+    size_t size = sketch->sizes[0];
+    if (reserve_level(sketch, 0, size + room) != 0) return -1;
+
+    double *level = sketch->levels[0];
+    double min = sketch->min, max = sketch->max;
+    for (; i < n_elements && room > 0; i++) {
+      double x = data[i];
+      if (isnan(x)) continue;
+      level[size++] = x;
+      room--;
+      if (!(x >= min)) min = x;
+      if (!(x <= max)) max = x;
+    }
+    sketch->count += size - sketch->sizes[0];
+    sketch->n_items += size - sketch->sizes[0];
+    sketch->sizes[0] = size;
+    sketch->min = min;
+    sketch->max = max;
+
+    if (room == 0 && compress(sketch) != 0) return -1;
+  }
+  return 0;
+}
+
+int amath_sketch_merge(QuantileSketch *sketch, const QuantileSketch *other) {
+  if (sketch == NULL || other == NULL || sketch == other) return -1;
+  if (other->count == 0) return 0;
+
+  if (other->k < sketch->k) sketch->k = other->k;
+  set_levels(sketch, sketch->n_levels > other->n_levels ? sketch->n_levels : other->n_levels);
+
+  if (reserve_level(sketch, 0, sketch->sizes[0] + other->sizes[0]) != 0) return -1;
+  memcpy(sketch->levels[0] + sketch->sizes[0], other->levels[0], sizeof(double) * other->sizes[0]);
+  sketch->sizes[0] += other->sizes[0];
+  sketch->n_items += other->sizes[0];
+  for (size_t h = 1; h < other->n_levels; h++) {
+    if (merge_into_level(sketch, h, other->levels[h], other->sizes[h]) != 0) return -1;
+  }
+
+  sketch->count += other->count;
+  if (!(other->min >= sketch->min)) sketch->min = other->min;
+  if (!(other->max <= sketch->max)) sketch->max = other->max;
+  return compress(sketch);
+}
+
+unsigned long long amath_sketch_count(const QuantileSketch *sketch) {
+  return sketch != NULL ? sketch->count : 0;
+}
+
+double amath_sketch_quantile(const QuantileSketch *sketch, double q) {
+  if (sketch == NULL || sketch->count == 0 || !(q >= 0 && q <= 1)) return NAN;
+  if (q == 0) return sketch->min;
+  if (q == 1) return sketch->max;
+
+  size_t n = sketch->n_items;
+  double *items = malloc(sizeof(double) * n);
+  size_t *order = malloc(sizeof(size_t) * n);
+  unsigned char *levels = malloc(n);
+  if (items == NULL || order == NULL || levels == NULL) {
+    free(items);
+    free(order);
+    free(levels);
+    return NAN;
+  }
+
+  size_t position = 0;
+  for (size_t h = 0; h < sketch->n_levels; h++) {
+    memcpy(items + position, sketch->levels[h], sizeof(double) * sketch->sizes[h]);
+    memset(levels + position, (int)h, sketch->sizes[h]);
+    position += sketch->sizes[h];
+  }
+
+  double result = sketch->max;
+  if (amath_argsort(items, n, order, 1) != 0) {
+    result = NAN;
+  } else {
+    /* The first item whose cumulative weight reaches q of the stream. */
+    double target = q * sketch->count, weight = 0;
+    for (size_t i = 0; i < n; i++) {
+      weight += (double)(1ULL << levels[order[i]]);
+      if (weight >= target) {
+        result = items[order[i]];
+        break;
+      }
+    }
+  }
+
+  free(items);
+  free(order);
+  free(levels);
+  return result;
+}
+
+double amath_sketch_rank(const QuantileSketch *sketch, double value) {
+  if (sketch == NULL || sketch->count == 0 || isnan(value)) return NAN;
+
+  double weight = 0;
+  for (size_t h = 0; h < sketch->n_levels; h++) {
+    size_t below = 0;
+    for (size_t i = 0; i < sketch->sizes[h]; i++) below += sketch->levels[h][i] <= value;
+    weight += (double)below * (double)(1ULL << h);
+  }
+  double rank = weight / sketch->count;
+  return rank < 1 ? rank : 1;
+}
+
+unsigned char *amath_sketch_serialize(const QuantileSketch *sketch, size_t *n_bytes) {
+  if (sketch == NULL || n_bytes == NULL) return NULL;
+
+  size_t n_items = sketch->n_items;
+  size_t size = sizeof(struct sketch_header) + sizeof(uint32_t) * sketch->n_levels + sizeof(double) * n_items;
+  unsigned char *buffer = malloc(size);
+  if (buffer == NULL) return NULL;
+
+  struct sketch_header header = {
+    .magic = SKETCH_MAGIC, .k = sketch->k, .n_levels = (uint32_t)sketch->n_levels, .reserved = 0,
+    .count = sketch->count, .min = sketch->min, .max = sketch->max, .random = sketch->random
+  };
+  unsigned char *position = buffer;
+  memcpy(position, &header, sizeof(header));
+  position += sizeof(header);
+  for (size_t h = 0; h < sketch->n_levels; h++) {
+    uint32_t level_size = (uint32_t)sketch->sizes[h];
+    memcpy(position, &level_size, sizeof(level_size));
+    position += sizeof(level_size);
+  }
+  for (size_t h = 0; h < sketch->n_levels; h++) {
+    memcpy(position, sketch->levels[h], sizeof(double) * sketch->sizes[h]);
+    position += sizeof(double) * sketch->sizes[h];
+  }
+
+  *n_bytes = size;
+  return buffer;
+}
+
+QuantileSketch *amath_sketch_deserialize(const unsigned char *buffer, size_t n_bytes) {
+  struct sketch_header header;
+  if (buffer == NULL || n_bytes < sizeof(header)) return NULL;
+  memcpy(&header, buffer, sizeof(header));
+  if (header.magic != SKETCH_MAGIC || header.k < SKETCH_MIN_K || header.k > SKETCH_MAX_K || header.n_levels == 0 ||
+      header.n_levels > SKETCH_MAX_LEVELS) {
+    return NULL;
+  }
+
+  const unsigned char *position = buffer + sizeof(header);
+  size_t sizes_bytes = sizeof(uint32_t) * header.n_levels;
+  if (n_bytes - sizeof(header) < sizes_bytes) return NULL;
+
+  uint32_t sizes[SKETCH_MAX_LEVELS];
+  memcpy(sizes, position, sizes_bytes);
+  position += sizes_bytes;
+  /* Every item of level h stands for 2^h values, and together they make up the count. */
+  size_t n_items = 0;
+  unsigned long long weight = 0;
+  for (size_t h = 0; h < header.n_levels; h++) {
+    if (sizes[h] > (ULLONG_MAX - weight) >> h) return NULL;
+    n_items += sizes[h];
+    weight += (unsigned long long)sizes[h] << h;
+  }
+  if (weight != header.count) return NULL;
+  if (n_bytes - sizeof(header) - sizes_bytes != sizeof(double) * n_items) return NULL;
+
+  QuantileSketch *s = amath_sketch_create(header.k);
+  if (s == NULL || header.random == 0) {
+    amath_destroy_sketch(s);
+    return NULL;
+  }
+  set_levels(s, header.n_levels);
+
+  /*
+    Compaction is lazy, so a single level may hold more than its own capacity, but
+    the sketch always stays below its total capacity, which update relies on.
+  */
+  if (n_items >= s->capacity) {
+    amath_destroy_sketch(s);
+    return NULL;
+  }
+  s->count = header.count;
+  s->min = header.min;
+  s->max = header.max;
+  s->random = header.random;
+
+  for (size_t h = 0; h < header.n_levels; h++) {
+    if (reserve_level(s, h, sizes[h]) != 0) {
+      amath_destroy_sketch(s);
+      return NULL;
+    }
+    memcpy(s->levels[h], position, sizeof(double) * sizes[h]);
+    s->sizes[h] = sizes[h];
+    s->n_items += sizes[h];
+    position += sizeof(double) * sizes[h];
+
+    /* Levels above 0 are sorted, and no level holds NaNs. */
+    const double *items = s->levels[h];
+    for (size_t i = 0; i < sizes[h]; i++) {
+      if (isnan(items[i]) || (h > 0 && i > 0 && items[i - 1] > items[i])) {
+        amath_destroy_sketch(s);
+        return NULL;
+      }
+    }
+  }
+  return s;
+}
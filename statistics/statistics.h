@@ -0,0 +1,40 @@
+#ifndef __AMATH_STATISTICS
+#define __AMATH_STATISTICS
+
+#include <stddef.h>
+
+/*
+  Internal helpers shared by the statistics modules. These symbols are not part
+  of the public API.
+*/
+
+#define STATISTICS_INTERNAL __attribute__((visibility("hidden")))
+
+/*
+  Stores in ranks the average rank (starting at 1) of each of the n elements of data.
+  Returns 0 if successfull, Return -1 if not.
+*/
+STATISTICS_INTERNAL int statistics_rank_values(double *data, size_t n, double *ranks, size_t n_threads);
+
+/*
+  Returns the number of pairs of tied elements of data, given the order that sorts it.
+*/
+STATISTICS_INTERNAL double kendall_tie_pairs(const double *data, const size_t *order, size_t n);
+
+/*
+  Kendall's tau-a between x and y in O(n log n) (Knight's algorithm), given the order
+  that sorts x and the tie pair counts of both arrays. buffer must hold 2 * n doubles.
+  Matches amath_kcorr: tied pairs count as neither concordant nor discordant.
+  Returns NAN on error.
+*/
+STATISTICS_INTERNAL double kendall_tau_sorted(
+  const double *x,
+  const double *y,
+  const size_t *x_order,
+  size_t n,
+  double x_tie_pairs,
+  double y_tie_pairs,
+  double *buffer
+);
+
+#endif  // __AMATH_STATISTICS
@@ -0,0 +1,158 @@
+#include "../amath.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+  Regression checks for amath_sketch_deserialize: buffers from other processes must
+  be rejected unless they describe a sketch that update and merge can grow safely.
+  Malformed buffers are made by patching the output of amath_sketch_serialize, whose
+  header fields are found by value, and whose level sizes and items sit at its end.
+*/
+
+static int failures;
+
+static void check(int condition, const char *name) {
+  printf("%-48s %s\n", name, condition ? "ok" : "FAILED");
+  if (!condition) failures++;
+}
+
+/* Returns a sketch with accuracy k holding the n_values values 0.1, 1.1, 2.1, ... */
+static QuantileSketch *filled(unsigned int k, size_t n_values) {
+  QuantileSketch *sketch = amath_sketch_create(k);
+  for (size_t i = 0; i < n_values; i++) {
+    double value = i + 0.1;
+    amath_sketch_update(sketch, &value, 1);
+  }
+  return sketch;
+}
+
+/* Offset of the only copy of value in the first n_bytes of buffer, or SIZE_MAX if there isn't exactly one. */
+static size_t find(const unsigned char *buffer, size_t n_bytes, const void *value, size_t size) {
+  size_t found = SIZE_MAX;
+  for (size_t i = 0; i + size <= n_bytes; i++) {
+    if (memcmp(buffer + i, value, size) != 0) continue;
+    if (found != SIZE_MAX) return SIZE_MAX;
+    found = i;
+  }
+  return found;
+}
+
+/* Replaces the only copy of the count in the header of a buffer of header_bytes. */
+static int patch_count(unsigned char *buffer, size_t header_bytes, unsigned long long from, unsigned long long to) {
+  size_t offset = find(buffer, header_bytes, &from, sizeof(from));
+  if (offset == SIZE_MAX) return 0;
+  memcpy(buffer + offset, &to, sizeof(to));
+  return 1;
+}
+
+/* Deserialises the buffer and checks that the sketch takes more values without trouble. */
+static int accepts(const unsigned char *buffer, size_t n_bytes) {
+  QuantileSketch *sketch = amath_sketch_deserialize(buffer, n_bytes);
+  if (sketch == NULL) return 0;
+
+  double values[1000];
+  for (size_t i = 0; i < 1000; i++) values[i] = (double)i;
+  int status = amath_sketch_update(sketch, values, 1000);
+  amath_destroy_sketch(sketch);
+  return status == 0;
+}
+
+int main(void) {
+  size_t n_bytes;
+
+  /* 150 values fit in the single level of a sketch with k = 300. */
+  QuantileSketch *sketch = filled(300, 150);
+  unsigned char *buffer = amath_sketch_serialize(sketch, &n_bytes);
+  size_t header_bytes = n_bytes - sizeof(uint32_t) - sizeof(double) * 150;
+  check(accepts(buffer, n_bytes), "accepts a well-formed buffer");
+
+  patch_count(buffer, header_bytes, 150, 151);
+  check(!accepts(buffer, n_bytes), "rejects a count that doesn't match the items");
+  patch_count(buffer, header_bytes, 151, 150);
+
+  uint32_t k = 300, too_large = 65536;
+  size_t k_offset = find(buffer, header_bytes, &k, sizeof(k));
+  if (k_offset != SIZE_MAX) memcpy(buffer + k_offset, &too_large, sizeof(too_large));
+  check(k_offset != SIZE_MAX && !accepts(buffer, n_bytes), "rejects k over the maximum");
+  QuantileSketch *largest = amath_sketch_create(65535);
+  check(largest != NULL && amath_sketch_create(65536) == NULL, "caps k when creating a sketch");
+  amath_destroy_sketch(largest);
+  free(buffer);
+  amath_destroy_sketch(sketch);
+
+  /* 5 values in a sketch with k = 8, grown to 100 items, over its capacity of 8. */
+  sketch = filled(8, 5);
+  buffer = amath_sketch_serialize(sketch, &n_bytes);
+  header_bytes = n_bytes - sizeof(uint32_t) - sizeof(double) * 5;
+  size_t oversized_bytes = n_bytes + sizeof(double) * 95;
+  unsigned char *oversized = malloc(oversized_bytes);
+  memcpy(oversized, buffer, n_bytes);
+  uint32_t n_items = 100;
+  memcpy(oversized + header_bytes, &n_items, sizeof(n_items));
+  for (size_t i = 5; i < 100; i++) {
+    double value = i + 0.1;
+    memcpy(oversized + header_bytes + sizeof(uint32_t) + sizeof(double) * i, &value, sizeof(value));
+  }
+  check(patch_count(oversized, header_bytes, 5, 100) && !accepts(oversized, oversized_bytes),
+        "rejects more items than the capacity");
+  free(oversized);
+  free(buffer);
+  amath_destroy_sketch(sketch);
+
+  /*
+    8 values fill a sketch with k = 8, whose compaction leaves 4 sorted items in level 1
+    and moves its random state on. A new sketch merged with it holds the same items
+    with the initial state, so the two buffers only differ by the random state.
+  */
+  QuantileSketch *compacted = filled(8, 8), *merged = amath_sketch_create(8);
+  amath_sketch_merge(merged, compacted);
+  size_t merged_bytes;
+  buffer = amath_sketch_serialize(compacted, &n_bytes);
+  unsigned char *initial = amath_sketch_serialize(merged, &merged_bytes);
+  check(accepts(buffer, n_bytes), "accepts sorted upper levels");
+
+  size_t first = n_bytes, last = 0;
+  for (size_t i = 0; merged_bytes == n_bytes && i < n_bytes; i++) {
+    if (buffer[i] == initial[i]) continue;
+    if (first == n_bytes) first = i;
+    last = i;
+  }
+  if (last + 1 - first == sizeof(uint64_t)) memset(buffer + first, 0, sizeof(uint64_t));
+  check(last + 1 - first == sizeof(uint64_t) && !accepts(buffer, n_bytes), "rejects a zero random state");
+  memcpy(buffer + first, initial + first, sizeof(uint64_t));
+
+  double *items = (double *)(buffer + n_bytes - sizeof(double) * 4);
+  double lowest = items[0];
+  items[0] = items[3] + 1;
+  check(amath_sketch_deserialize(buffer, n_bytes) == NULL, "rejects an unsorted upper level");
+  items[0] = NAN;
+  check(amath_sketch_deserialize(buffer, n_bytes) == NULL, "rejects NaN items");
+  items[0] = lowest;
+  check(accepts(buffer, n_bytes) && amath_sketch_deserialize(buffer, n_bytes - 1) == NULL,
+        "rejects a truncated buffer");
+  free(initial);
+  free(buffer);
+  amath_destroy_sketch(merged);
+  amath_destroy_sketch(compacted);
+
+  /* Real sketches, merged or not, must round-trip. */
+  sketch = amath_sketch_create(0);
+  QuantileSketch *other = amath_sketch_create(0);
+  double *values = malloc(sizeof(double) * 100000);
+  for (size_t i = 0; i < 100000; i++) values[i] = (double)((i * 2654435761u) % 100003);
+  amath_sketch_update(sketch, values, 100000);
+  amath_sketch_update(other, values, 50000);
+  amath_sketch_merge(sketch, other);
+  buffer = amath_sketch_serialize(sketch, &n_bytes);
+  QuantileSketch *copy = amath_sketch_deserialize(buffer, n_bytes);
+  check(copy != NULL && amath_sketch_quantile(copy, 0.5) == amath_sketch_quantile(sketch, 0.5),
+        "round-trips a merged sketch");
+  amath_destroy_sketch(copy);
+  amath_destroy_sketch(sketch);
+  amath_destroy_sketch(other);
+  free(buffer);
+  free(values);
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}